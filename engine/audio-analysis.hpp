@@ -0,0 +1,274 @@
+#pragma once
+
+// Every frame, the window of the sound buffer centered on the playback position goes through an FFT.
+// Synthesizers give their buffer as AUDIO_WAVE_HEADER, since the samples are already there the cost is fixed.
+//
+// Shaders read the magnitude of each frequency from a 512 texels wide float texture:
+//     uniform sampler2D audioSpectrum;
+//     float magnitude = texture(audioSpectrum, vec2(frequency / 22050., .5)).r;
+// and the energies of three bands, with a value set to 1 on each onset, from float uniforms:
+//     uniform float audioBass, audioMid, audioTreble, audioOnset;
+// Values rise at once and fall by a constant factor on each frame.
+//
+// Butterflies and magnitudes are computed four at a time with SSE.
+// Captures do not play the song, it is rendered before the first frame so that every frame is analyzed the same way.
+
+#ifdef AUDIO_ANALYSIS
+
+#include <math.h>
+#include <xmmintrin.h>
+
+#ifndef AUDIO_WAVE_HEADER
+#error demo:audioAnalysis needs a synthesizer which gives its buffer as AUDIO_WAVE_HEADER.
+#endif
+
+#if defined(CAPTURE) && !defined(HAS_HOOK_AUDIO_RENDER) && !defined(AUDIO_RENDERED_AT_INITIALIZE)
+#error demo:audioAnalysis in captures needs a synthesizer which renders the whole song before the first frame.
+#endif
+
+// About 23 milliseconds at 44100 Hz.
+#define AUDIO_ANALYSIS_FFT_SIZE 1024
+#define AUDIO_ANALYSIS_FFT_LOG_SIZE 10
+#define AUDIO_ANALYSIS_BIN_COUNT (AUDIO_ANALYSIS_FFT_SIZE / 2)
+
+// The last unit tracked by the OpenGL state cache, render graph inputs start from the first one.
+#define AUDIO_ANALYSIS_TEXTURE_UNIT 15
+
+#define AUDIO_ANALYSIS_BIN(frequency) ((frequency) * AUDIO_ANALYSIS_FFT_SIZE / SAMPLE_RATE)
+#define AUDIO_ANALYSIS_BASS_END AUDIO_ANALYSIS_BIN(250)
+#define AUDIO_ANALYSIS_MID_END AUDIO_ANALYSIS_BIN(4000)
+
+#define AUDIO_ANALYSIS_DECAY 0.9f
+
+// An onset is a spectral flux this much above its recent average.
+#define AUDIO_ANALYSIS_ONSET_THRESHOLD 1.5f
+#define AUDIO_ANALYSIS_FLUX_SMOOTHING 0.1f
+
+static GLuint audioAnalysisTexture;
+
+// Twiddle factors for the first half of the circle, which also give the Hann window.
+static float audioAnalysisCos[AUDIO_ANALYSIS_BIN_COUNT];
+static float audioAnalysisSin[AUDIO_ANALYSIS_BIN_COUNT];
+static short audioAnalysisReversedIndices[AUDIO_ANALYSIS_FFT_SIZE];
+
+// The twiddle factors of the stage with half size h start at index h, contiguous so that they load four at a time.
+static float audioAnalysisStageCos[AUDIO_ANALYSIS_FFT_SIZE];
+static float audioAnalysisStageSin[AUDIO_ANALYSIS_FFT_SIZE];
+
+static float audioAnalysisReal[AUDIO_ANALYSIS_FFT_SIZE];
+static float audioAnalysisImaginary[AUDIO_ANALYSIS_FFT_SIZE];
+static float audioAnalysisMagnitudes[AUDIO_ANALYSIS_BIN_COUNT];
+static float audioAnalysisSpectrum[AUDIO_ANALYSIS_BIN_COUNT];
+static float audioAnalysisFluxAverage;
+
+// Rounds without the float to integer conversion of the C runtime:
+// adding 1.5 * 2^52 leaves the rounded value in the low bits of the mantissa.
+static int audioAnalysisRound(double value)
+{
+	union
+	{
+		double value;
+		int words[2];
+	} bits;
+	bits.value = value + 6755399441055744.0;
+	return bits.words[0];
+}
+
+static void audioAnalysisInitialize(const GLint *programs, int programCount)
+{
+	// The angle of the first twiddle factor is found by halving pi, the others by rotating it.
+	double cosine = -1.0;
+	double sine = 0.0;
+	for (int i = 1; i < AUDIO_ANALYSIS_FFT_LOG_SIZE; ++i)
+	{
+		sine = sqrt((1.0 - cosine) * 0.5);
+		cosine = sqrt((1.0 + cosine) * 0.5);
+	}
+
+	double twiddleCos = 1.0;
+	double twiddleSin = 0.0;
+	for (int i = 0; i < AUDIO_ANALYSIS_BIN_COUNT; ++i)
+	{
+		audioAnalysisCos[i] = (float)twiddleCos;
+		audioAnalysisSin[i] = (float)twiddleSin;
+
+		double rotatedCos = twiddleCos * cosine - twiddleSin * sine;
+		twiddleSin = twiddleSin * cosine + twiddleCos * sine;
+		twiddleCos = rotatedCos;
+	}
+
+	for (int i = 0; i < AUDIO_ANALYSIS_FFT_SIZE; ++i)
+	{
+		int reversed = 0;
+		for (int bit = 0; bit < AUDIO_ANALYSIS_FFT_LOG_SIZE; ++bit)
+		{
+			reversed |= ((i >> bit) & 1) << (AUDIO_ANALYSIS_FFT_LOG_SIZE - 1 - bit);
+		}
+		audioAnalysisReversedIndices[i] = (short)reversed;
+	}
+
+	for (int half = 1, step = AUDIO_ANALYSIS_BIN_COUNT; half < AUDIO_ANALYSIS_FFT_SIZE; half *= 2, step /= 2)
+	{
+		for (int k = 0; k < half; ++k)
+		{
+			audioAnalysisStageCos[half + k] = audioAnalysisCos[k * step];
+			audioAnalysisStageSin[half + k] = audioAnalysisSin[k * step];
+		}
+	}
+
+	// Direct state access leaves the bindings of the hooks untouched.
+	glCreateTextures(GL_TEXTURE_2D, 1, &audioAnalysisTexture);
+	checkGLError();
+	glTextureStorage2D(audioAnalysisTexture, 1, GL_R32F, AUDIO_ANALYSIS_BIN_COUNT, 1);
+	checkGLError();
+	glTextureParameteri(audioAnalysisTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	checkGLError();
+	glBindTextureUnit(AUDIO_ANALYSIS_TEXTURE_UNIT, audioAnalysisTexture);
+	checkGLError();
+
+	for (int i = 0; i < programCount; ++i)
+	{
+		glProgramUniform1i(programs[i], glGetUniformLocation(programs[i], "audioSpectrum"), AUDIO_ANALYSIS_TEXTURE_UNIT);
+		checkGLError();
+	}
+}
+
+static void audioAnalysisUpdate(float time)
+{
+	const SAMPLE_TYPE *samples = (const SAMPLE_TYPE *)AUDIO_WAVE_HEADER.lpData;
+	int sampleCount = AUDIO_WAVE_HEADER.dwBufferLength / (sizeof(SAMPLE_TYPE) * 2);
+	int start = audioAnalysisRound((double)time * SAMPLE_RATE) - AUDIO_ANALYSIS_FFT_SIZE / 2;
+
+	// Mono samples, through a Hann window, in bit reversed order.
+	for (int i = 0; i < AUDIO_ANALYSIS_FFT_SIZE; ++i)
+	{
+		float sample = 0.0f;
+		int index = start + i;
+		if (index >= 0 && index < sampleCount)
+		{
+#ifdef FLOAT_32BIT
+			sample = (samples[index * 2] + samples[index * 2 + 1]) * 0.5f;
+#else
+			sample = (float)(samples[index * 2] + samples[index * 2 + 1]) * (0.5f / 32768.0f);
+#endif
+		}
+
+		float cosine = i < AUDIO_ANALYSIS_BIN_COUNT ? audioAnalysisCos[i] : -audioAnalysisCos[i - AUDIO_ANALYSIS_BIN_COUNT];
+		int reversed = audioAnalysisReversedIndices[i];
+		audioAnalysisReal[reversed] = sample * (0.5f - 0.5f * cosine);
+		audioAnalysisImaginary[reversed] = 0.0f;
+	}
+
+	// Radix 2 butterflies, four at a time once groups are large enough.
+	for (int half = 1; half < AUDIO_ANALYSIS_FFT_SIZE; half *= 2)
+	{
+		const float *stageCos = audioAnalysisStageCos + half;
+		const float *stageSin = audioAnalysisStageSin + half;
+
+		for (int group = 0; group < AUDIO_ANALYSIS_FFT_SIZE; group += half * 2)
+		{
+			float *evenReal = audioAnalysisReal + group;
+			float *evenImaginary = audioAnalysisImaginary + group;
+			float *oddReal = evenReal + half;
+			float *oddImaginary = evenImaginary + half;
+
+			int k = 0;
+			for (; k + 4 <= half; k += 4)
+			{
+				__m128 twiddleCos = _mm_loadu_ps(stageCos + k);
+				__m128 twiddleSin = _mm_loadu_ps(stageSin + k);
+				__m128 oddR = _mm_loadu_ps(oddReal + k);
+				__m128 oddI = _mm_loadu_ps(oddImaginary + k);
+				__m128 evenR = _mm_loadu_ps(evenReal + k);
+				__m128 evenI = _mm_loadu_ps(evenImaginary + k);
+
+				__m128 real = _mm_add_ps(_mm_mul_ps(oddR, twiddleCos), _mm_mul_ps(oddI, twiddleSin));
+				__m128 imaginary = _mm_sub_ps(_mm_mul_ps(oddI, twiddleCos), _mm_mul_ps(oddR, twiddleSin));
+				_mm_storeu_ps(oddReal + k, _mm_sub_ps(evenR, real));
+				_mm_storeu_ps(oddImaginary + k, _mm_sub_ps(evenI, imaginary));
+				_mm_storeu_ps(evenReal + k, _mm_add_ps(evenR, real));
+				_mm_storeu_ps(evenImaginary + k, _mm_add_ps(evenI, imaginary));
+			}
+
+			for (; k < half; ++k)
+			{
+				float real = oddReal[k] * stageCos[k] + oddImaginary[k] * stageSin[k];
+				float imaginary = oddImaginary[k] * stageCos[k] - oddReal[k] * stageSin[k];
+				oddReal[k] = evenReal[k] - real;
+				oddImaginary[k] = evenImaginary[k] - imaginary;
+				evenReal[k] += real;
+				evenImaginary[k] += imaginary;
+			}
+		}
+	}
+
+	// A full scale sine gives a magnitude of 1, through the Hann window.
+	// Magnitudes overwrite the real parts, which are not needed anymore.
+	const __m128 magnitudeScale = _mm_set1_ps(4.0f / AUDIO_ANALYSIS_FFT_SIZE);
+	for (int i = 0; i < AUDIO_ANALYSIS_BIN_COUNT; i += 4)
+	{
+		__m128 real = _mm_loadu_ps(audioAnalysisReal + i);
+		__m128 imaginary = _mm_loadu_ps(audioAnalysisImaginary + i);
+		__m128 squared = _mm_add_ps(_mm_mul_ps(real, real), _mm_mul_ps(imaginary, imaginary));
+		_mm_storeu_ps(audioAnalysisReal + i, _mm_mul_ps(_mm_sqrt_ps(squared), magnitudeScale));
+	}
+
+	float bass = 0.0f;
+	float mid = 0.0f;
+	float treble = 0.0f;
+	float flux = 0.0f;
+	for (int i = 0; i < AUDIO_ANALYSIS_BIN_COUNT; ++i)
+	{
+		float magnitude = audioAnalysisReal[i];
+
+		if (magnitude > audioAnalysisMagnitudes[i])
+		{
+			flux += magnitude - audioAnalysisMagnitudes[i];
+		}
+		audioAnalysisMagnitudes[i] = magnitude;
+
+		float decayed = audioAnalysisSpectrum[i] * AUDIO_ANALYSIS_DECAY;
+		audioAnalysisSpectrum[i] = magnitude > decayed ? magnitude : decayed;
+
+		float energy = magnitude * magnitude;
+		if (i < AUDIO_ANALYSIS_BASS_END)
+		{
+			bass += energy;
+		}
+		else if (i < AUDIO_ANALYSIS_MID_END)
+		{
+			mid += energy;
+		}
+		else
+		{
+			treble += energy;
+		}
+	}
+
+	glTextureSubImage2D(audioAnalysisTexture, 0, 0, 0, AUDIO_ANALYSIS_BIN_COUNT, 1, GL_RED, GL_FLOAT, audioAnalysisSpectrum);
+	checkGLError();
+
+	// Bands are the root of the energy of their bins.
+#ifdef uniformAudioBass
+	bass = sqrtf(bass);
+	uniformAudioBass = bass > uniformAudioBass * AUDIO_ANALYSIS_DECAY ? bass : uniformAudioBass * AUDIO_ANALYSIS_DECAY;
+#endif
+
+#ifdef uniformAudioMid
+	mid = sqrtf(mid);
+	uniformAudioMid = mid > uniformAudioMid * AUDIO_ANALYSIS_DECAY ? mid : uniformAudioMid * AUDIO_ANALYSIS_DECAY;
+#endif
+
+#ifdef uniformAudioTreble
+	treble = sqrtf(treble);
+	uniformAudioTreble = treble > uniformAudioTreble * AUDIO_ANALYSIS_DECAY ? treble : uniformAudioTreble * AUDIO_ANALYSIS_DECAY;
+#endif
+
+#ifdef uniformAudioOnset
+	uniformAudioOnset = flux > audioAnalysisFluxAverage * AUDIO_ANALYSIS_ONSET_THRESHOLD && flux > 0.01f ? 1.0f : uniformAudioOnset * AUDIO_ANALYSIS_DECAY;
+#endif
+
+	audioAnalysisFluxAverage += (flux - audioAnalysisFluxAverage) * AUDIO_ANALYSIS_FLUX_SMOOTHING;
+}
+
+#endif
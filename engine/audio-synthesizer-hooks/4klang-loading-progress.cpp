@@ -0,0 +1,97 @@
+#pragma hook declarations
+
+// Added after 4klang.cpp when demo:audio-synthesizer:loadingProgress is set.
+
+#include <intrin.h>
+
+// The song is rendered in order on its own thread, and played once the rendered samples are safely ahead.
+// Samples not rendered yet hold a value which the synthesizer does not write:
+// a NaN in float, or the lowest value in 16 bits where only a clipped sample could hold it.
+// The watermark is the count of stereo samples rendered, found by scanning the buffer from the previous one.
+#ifdef FLOAT_32BIT
+#define AUDIO_UNRENDERED_SAMPLE 0xffffffff
+typedef DWORD AudioSampleBits;
+#else
+#define AUDIO_UNRENDERED_SAMPLE 0x8000
+typedef WORD AudioSampleBits;
+#endif
+
+// Lead of the rendered samples over the playback cursor.
+#define AUDIO_SAFETY_MARGIN (SAMPLE_RATE / 2)
+
+// A clipped sample holding the unrendered value is stepped over once a sample this close after it is rendered.
+#define AUDIO_UNRENDERED_LOOKAHEAD 4096
+
+static HANDLE audioRenderThread;
+static DWORD audioRenderStartTime;
+static int audioWatermark;
+
+static void audioStartRender()
+{
+#ifdef FLOAT_32BIT
+	__stosd((unsigned long *)soundBuffer, AUDIO_UNRENDERED_SAMPLE, MAX_SAMPLES * 2);
+#else
+	__stosw((unsigned short *)soundBuffer, AUDIO_UNRENDERED_SAMPLE, MAX_SAMPLES * 2);
+#endif
+
+	audioRenderStartTime = GetTickCount();
+	audioRenderThread = CreateThread(0, 0, (LPTHREAD_START_ROUTINE)_4klang_render, soundBuffer, 0, 0);
+}
+
+// Fraction of the samples needed before the playback can start.
+static float audioLoadingProgress()
+{
+	volatile AudioSampleBits *samples = (volatile AudioSampleBits *)soundBuffer;
+	while (audioWatermark < MAX_SAMPLES)
+	{
+		if (samples[audioWatermark * 2 + 1] != AUDIO_UNRENDERED_SAMPLE)
+		{
+			++audioWatermark;
+			continue;
+		}
+
+		// Samples are rendered in order, so the thread has moved past this one if a later one is rendered.
+		int next = audioWatermark + 1;
+		while (next < MAX_SAMPLES && next - audioWatermark < AUDIO_UNRENDERED_LOOKAHEAD && samples[next * 2 + 1] == AUDIO_UNRENDERED_SAMPLE)
+		{
+			++next;
+		}
+
+		if (next == MAX_SAMPLES || next - audioWatermark == AUDIO_UNRENDERED_LOOKAHEAD)
+		{
+			break;
+		}
+
+		audioWatermark = next;
+	}
+
+	// Longer runs of clipped samples stop the scan until the end of the thread, which tells that all are rendered.
+	if (audioWatermark == MAX_SAMPLES || WaitForSingleObject(audioRenderThread, 0) == WAIT_OBJECT_0)
+	{
+		return 1.0f;
+	}
+
+	// A synthesizer slower than the playback must be far enough to finish before the cursor reaches the end.
+	float renderSpeed = (float)audioWatermark / (float)((int)(GetTickCount() - audioRenderStartTime) + 1) * 1000.0f;
+	float neededSamples = (float)MAX_SAMPLES - (float)(MAX_SAMPLES - AUDIO_SAFETY_MARGIN) * renderSpeed / (float)SAMPLE_RATE;
+	if (neededSamples < (float)AUDIO_SAFETY_MARGIN)
+	{
+		neededSamples = (float)AUDIO_SAFETY_MARGIN;
+	}
+
+	return (float)audioWatermark / neededSamples;
+}
+
+#pragma hook audio_start
+
+audioStartRender();
+
+#pragma hook audio_loading_progress
+
+audioLoadingProgress()
+
+#pragma hook audio_play
+
+waveOutOpen(&waveOut, WAVE_MAPPER, &waveFormat, NULL, 0, CALLBACK_NULL);
+waveOutPrepareHeader(waveOut, &waveHDR, sizeof(waveHDR));
+waveOutWrite(waveOut, &waveHDR, sizeof(waveHDR));
@@ -39,12 +39,22 @@ static MMTIME mmTime = {
 	0,
 };
 
+#define AUDIO_WAVE_FORMAT waveFormat
+#define AUDIO_WAVE_HEADER waveHDR
+
 #pragma hook audio_start
 
+// With demo:audio-synthesizer:loadingProgress, 4klang-loading-progress.cpp starts the render and the playback.
+#ifndef HAS_HOOK_AUDIO_LOADING_PROGRESS
 CreateThread(0, 0, (LPTHREAD_START_ROUTINE)_4klang_render, soundBuffer, 0, 0);
 waveOutOpen(&waveOut, WAVE_MAPPER, &waveFormat, NULL, 0, CALLBACK_NULL);
 waveOutPrepareHeader(waveOut, &waveHDR, sizeof(waveHDR));
 waveOutWrite(waveOut, &waveHDR, sizeof(waveHDR));
+#endif
+
+#pragma hook audio_render
+
+_4klang_render(soundBuffer);
 
 #pragma hook audio_time
 
@@ -53,7 +63,7 @@ float time = (float)mmTime.u.sample / (float)SAMPLE_RATE;
 
 #pragma hook audio_duration
 
-return MAX_SAMPLES / (float)SAMPLE_RATE;
+MAX_SAMPLES / (float)SAMPLE_RATE
 
 #pragma hook audio_is_playing
 
@@ -0,0 +1,80 @@
+#pragma hook declarations
+
+#include <stdarg.h>
+
+// Frames before the first measured one are warm-up frames, rendered at the start time.
+static int benchmarkFrameNumber;
+static int benchmarkFrameCount;
+static LARGE_INTEGER benchmarkLastCounter;
+
+// Lines on the standard error are parsed by the benchmark task.
+static void benchmarkLog(const char *format, ...)
+{
+	static char message[64];
+
+	va_list args;
+	va_start(args, format);
+	DWORD length = wvsprintfA(message, format, args);
+	va_end(args);
+
+	WriteFile(GetStdHandle(STD_ERROR_HANDLE), message, length, &length, NULL);
+}
+
+#pragma hook initialize
+
+{
+	float benchmarkEnd =
+#ifdef BENCHMARK_END
+		BENCHMARK_END
+#elif defined(DURATION)
+		DURATION
+#else
+		REPLACE_HOOK_AUDIO_DURATION
+#endif
+		;
+
+	benchmarkFrameCount = 0;
+	while (BENCHMARK_START + (float)benchmarkFrameCount / BENCHMARK_FPS < benchmarkEnd)
+	{
+		++benchmarkFrameCount;
+	}
+
+	benchmarkFrameNumber = -BENCHMARK_WARMUP_FRAMES;
+
+	// Ticks are reported as is, the benchmark task converts them.
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	benchmarkLog("benchmark frequency %u\n", (DWORD)frequency.QuadPart);
+	benchmarkLog("benchmark frames %d\n", benchmarkFrameCount);
+
+	QueryPerformanceCounter(&benchmarkLastCounter);
+}
+
+#pragma hook benchmark_time
+
+float time = BENCHMARK_START + (float)(benchmarkFrameNumber > 0 ? benchmarkFrameNumber : 0) / BENCHMARK_FPS;
+
+#pragma hook benchmark_is_playing
+
+benchmarkFrameNumber < benchmarkFrameCount
+
+#pragma hook benchmark_frame
+
+// Frames are not presented, so that the vertical sync does not cap them.
+// Waiting for the GPU makes each measure cover the whole frame.
+glFinish();
+checkGLError();
+
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	if (benchmarkFrameNumber >= 0)
+	{
+		benchmarkLog("benchmark frame %d %u\n", benchmarkFrameNumber, (DWORD)(counter.QuadPart - benchmarkLastCounter.QuadPart));
+	}
+
+	benchmarkLastCounter = counter;
+}
+
+++benchmarkFrameNumber;
@@ -0,0 +1,92 @@
+#pragma hook declarations
+
+// The music is synthesized offline on its own thread while frames are captured,
+// and written next to the frames as audio.wav, which the capture task muxes with them.
+// Synthesizers render the whole song in an audio_render hook,
+// and give the buffer they play as AUDIO_WAVE_FORMAT and AUDIO_WAVE_HEADER.
+
+// The header is written with empty sizes before the song is rendered, and patched once the samples follow it.
+// The file is complete when its RIFF size matches its length, an interrupted capture leaves it incomplete.
+#define CAPTURE_AUDIO_RIFF_SIZE_OFFSET 4
+#define CAPTURE_AUDIO_DATA_SIZE_OFFSET (20 + sizeof(WAVEFORMATEX) + 4)
+#define CAPTURE_AUDIO_HEADER_SIZE (CAPTURE_AUDIO_DATA_SIZE_OFFSET + 4)
+
+static HANDLE captureAudioFile = INVALID_HANDLE_VALUE;
+static HANDLE captureAudioThread;
+
+static bool captureIsAudioComplete()
+{
+	HANDLE file = CreateFile("audio.wav", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	DWORD riffHeader[2] = {};
+	DWORD bytesRead = 0;
+	ReadFile(file, riffHeader, sizeof(riffHeader), &bytesRead, NULL);
+	DWORD fileSize = GetFileSize(file, NULL);
+	CloseHandle(file);
+
+	return bytesRead == sizeof(riffHeader) && riffHeader[1] && riffHeader[1] + 8 == fileSize;
+}
+
+static DWORD WINAPI captureAudioRender(LPVOID)
+{
+	// Demos analyzing the music have synthesized it before the first frame.
+#ifndef AUDIO_ANALYSIS
+	REPLACE_HOOK_AUDIO_RENDER
+#endif
+
+	DWORD dataSize = AUDIO_WAVE_HEADER.dwBufferLength;
+	DWORD riffSize = CAPTURE_AUDIO_HEADER_SIZE - 8 + dataSize;
+
+	DWORD bytesWritten;
+	WriteFile(captureAudioFile, AUDIO_WAVE_HEADER.lpData, dataSize, &bytesWritten, NULL);
+
+	SetFilePointer(captureAudioFile, CAPTURE_AUDIO_DATA_SIZE_OFFSET, NULL, FILE_BEGIN);
+	WriteFile(captureAudioFile, &dataSize, sizeof(dataSize), &bytesWritten, NULL);
+	SetFilePointer(captureAudioFile, CAPTURE_AUDIO_RIFF_SIZE_OFFSET, NULL, FILE_BEGIN);
+	WriteFile(captureAudioFile, &riffSize, sizeof(riffSize), &bytesWritten, NULL);
+
+	CloseHandle(captureAudioFile);
+	return 0;
+}
+
+#pragma hook initialize
+
+// Every segment would render the same music: the first one to find it incomplete writes it,
+// the others can not open it for writing meanwhile.
+if (!captureIsAudioComplete())
+{
+	captureAudioFile = CreateFile("audio.wav", GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (captureAudioFile != INVALID_HANDLE_VALUE)
+	{
+		// The fmt chunk is the format as played.
+		DWORD riffHeader[] = {
+			0x46464952, // RIFF
+			0,
+			0x45564157, // WAVE
+			0x20746d66, // fmt
+			sizeof(WAVEFORMATEX),
+		};
+		DWORD dataHeader[] = {
+			0x61746164, // data
+			0,
+		};
+
+		DWORD bytesWritten;
+		WriteFile(captureAudioFile, riffHeader, sizeof(riffHeader), &bytesWritten, NULL);
+		WriteFile(captureAudioFile, &AUDIO_WAVE_FORMAT, sizeof(WAVEFORMATEX), &bytesWritten, NULL);
+		WriteFile(captureAudioFile, dataHeader, sizeof(dataHeader), &bytesWritten, NULL);
+
+		captureAudioThread = CreateThread(NULL, 0, captureAudioRender, NULL, 0, NULL);
+	}
+}
+
+#pragma hook capture_end
+
+if (captureAudioThread)
+{
+	WaitForMultipleObjects(1, &captureAudioThread, TRUE, INFINITE);
+}
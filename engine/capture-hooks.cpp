@@ -1,44 +1,745 @@
 #pragma hook declarations
 
+#include <stdarg.h>
+
+#include "../engine/command-line.hpp"
+
+#ifdef CAPTURE_PIXEL_FORMAT_YUV420P
+#define CAPTURE_FRAME_SIZE (resolutionWidth * resolutionHeight * 3 / 2 /* YUV420 */)
+#define CAPTURE_READ_FORMAT GL_RED
+#define CAPTURE_READ_HEIGHT (resolutionHeight * 3 / 2)
+#else
+#define CAPTURE_FRAME_SIZE (resolutionWidth * resolutionHeight * 3 /* RGB8 */)
+#define CAPTURE_READ_FORMAT GL_RGB
+#define CAPTURE_READ_HEIGHT resolutionHeight
+#endif
+
 static int frameNumber;
+static int captureFrameCount;
+static int captureStartFrame;
+static int captureEndFrame;
+
+// First frame rendered by this process, after the start frame when resuming.
+static int captureFirstFrame;
+static volatile LONG captureWrittenFrameCount;
+
+#ifndef CAPTURE_OUTPUT_PIPE
+static HANDLE captureManifestFile;
+#endif
+
+#if defined(CAPTURE_OUTPUT_STREAM) || defined(CAPTURE_OUTPUT_PIPE)
 static HANDLE frameFile;
-static DWORD frameBytesWritten;
+#endif
+
+#if CAPTURE_PBO_COUNT > 0
+static GLuint framePbos[CAPTURE_PBO_COUNT];
+#else
 static char *frameBuffer;
+#endif
+
+#if !defined(CAPTURE_OUTPUT_STREAM) && !defined(CAPTURE_OUTPUT_PIPE)
+// Frame numbers are written with at least 5 digits, as ffmpeg reads them with %05d, and at most 10.
+#define CAPTURE_FRAME_FILENAME_SIZE 16
 
-static char *frameFilename(int n)
+// Writer threads name frames concurrently, each one in its own buffer.
+static void frameFilename(char *name, int n)
 {
-	static char *name = "00000.raw";
-	char *ptr = name + 4;
+	int digitCount = 5;
+	for (int rest = n / 100000; rest; rest /= 10)
+	{
+		++digitCount;
+	}
 
-	while (n > 0)
+	for (int i = digitCount - 1; i >= 0; --i)
 	{
-		*ptr-- = (n - (n / 10) * 10) + '0';
+		name[i] = (n - (n / 10) * 10) + '0';
 		n /= 10;
 	}
 
-	return name;
+	name[digitCount] = '.';
+	name[digitCount + 1] = 'r';
+	name[digitCount + 2] = 'a';
+	name[digitCount + 3] = 'w';
+	name[digitCount + 4] = 0;
+}
+#endif
+
+// Lines on the standard error are parsed by the capture task.
+static void captureLog(const char *format, ...)
+{
+	static char message[64];
+
+	va_list args;
+	va_start(args, format);
+	DWORD length = wvsprintfA(message, format, args);
+	va_end(args);
+
+	WriteFile(GetStdHandle(STD_ERROR_HANDLE), message, length, &length, NULL);
+}
+
+#ifndef CAPTURE_OUTPUT_PIPE
+// Only the last frames of a segment are hashed, as many as the capture task checks when resuming.
+#define CAPTURE_HASHED_FRAME_COUNT 16
+
+// FNV-1a on little-endian 32-bit words, then on the remaining bytes, recomputed by the capture task.
+static DWORD captureChecksum(const char *data)
+{
+	const DWORD *words = (const DWORD *)data;
+	DWORD hash = 2166136261;
+	int i = 0;
+	for (; i < CAPTURE_FRAME_SIZE / 4; ++i)
+	{
+		hash = (hash ^ words[i]) * 16777619;
+	}
+
+	for (i *= 4; i < CAPTURE_FRAME_SIZE; ++i)
+	{
+		hash = (hash ^ (unsigned char)data[i]) * 16777619;
+	}
+
+	return hash;
+}
+#endif
+
+// The manifest is opened for appending only, so each line is written atomically,
+// whichever writer thread or segment writes it.
+// Frames are recorded once written, by the writer threads when there are some.
+static void captureRecordFrame(int n, const char *data)
+{
+	InterlockedIncrement(&captureWrittenFrameCount);
+
+#ifndef CAPTURE_OUTPUT_PIPE
+	char line[48];
+	DWORD length = n >= captureEndFrame - CAPTURE_HASHED_FRAME_COUNT
+		? wsprintfA(line, "frame %d %d %08x\n", n, CAPTURE_FRAME_SIZE, captureChecksum(data))
+		: wsprintfA(line, "frame %d %d\n", n, CAPTURE_FRAME_SIZE);
+	WriteFile(captureManifestFile, line, length, &length, NULL);
+#endif
+}
+
+#ifdef CAPTURE_OUTPUT_STREAM
+// Frames are written at their own offset, so that several writers can share the file.
+static void captureWriteFrame(int n, const char *data)
+{
+	ULARGE_INTEGER offset;
+	offset.QuadPart = UInt32x32To64(n, CAPTURE_FRAME_SIZE);
+
+	OVERLAPPED overlapped;
+	overlapped.Offset = offset.LowPart;
+	overlapped.OffsetHigh = offset.HighPart;
+	overlapped.hEvent = NULL;
+
+	DWORD bytesWritten;
+	if (WriteFile(frameFile, data, CAPTURE_FRAME_SIZE, &bytesWritten, &overlapped) && bytesWritten == CAPTURE_FRAME_SIZE)
+	{
+		captureRecordFrame(n, data);
+	}
+}
+#elif defined(CAPTURE_OUTPUT_PIPE)
+// Frames are written in order to the standard output.
+static void captureWriteFrame(int n, const char *data)
+{
+	DWORD bytesWritten;
+	if (WriteFile(frameFile, data, CAPTURE_FRAME_SIZE, &bytesWritten, NULL) && bytesWritten == CAPTURE_FRAME_SIZE)
+	{
+		captureRecordFrame(n, data);
+	}
+}
+#else
+static void captureWriteFrame(int n, const char *data)
+{
+	char name[CAPTURE_FRAME_FILENAME_SIZE];
+	frameFilename(name, n);
+
+	// A resumed capture overwrites the frames found missing or corrupt.
+	HANDLE file = CreateFile(name, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		DWORD bytesWritten;
+		if (WriteFile(file, data, CAPTURE_FRAME_SIZE, &bytesWritten, NULL) && bytesWritten == CAPTURE_FRAME_SIZE)
+		{
+			captureRecordFrame(n, data);
+		}
+		CloseHandle(file);
+	}
+}
+#endif
+
+#if CAPTURE_SUPERSAMPLING > 1 || CAPTURE_TILE_SIZE > 0
+#define CAPTURE_TILED
+#endif
+
+#if defined(CAPTURE_TILED) || CAPTURE_SUBFRAME_COUNT > 1
+#define CAPTURE_OFFSCREEN
+#endif
+
+// Helpers of the capture passes, which only run offscreen or to convert to YUV.
+#if defined(CAPTURE_OFFSCREEN) || defined(CAPTURE_PIXEL_FORMAT_YUV420P)
+static GLint captureProgramToRestore;
+
+// Capture passes run after the demo has rendered into the default framebuffer,
+// and must leave the state as the demo expects it for the next frame.
+static void captureSaveState()
+{
+	glGetIntegerv(GL_CURRENT_PROGRAM, &captureProgramToRestore);
+	checkGLError();
+	glPushAttrib(GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT | GL_SCISSOR_BIT | GL_TEXTURE_BIT | GL_VIEWPORT_BIT);
+	checkGLError();
+
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	checkGLError();
+
+	glActiveTexture(GL_TEXTURE0);
+	checkGLError();
+}
+
+static void captureRestoreState()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	checkGLError();
+	glPopAttrib();
+	checkGLError();
+	glUseProgram(captureProgramToRestore);
+	checkGLError();
+}
+
+static GLint captureCreateProgram(const char *fragmentShaderCode)
+{
+	GLint program = glCreateProgram();
+	checkGLError();
+
+	GLint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	checkGLError();
+	glShaderSource(fragmentShader, 1, &fragmentShaderCode, 0);
+	checkGLError();
+	glCompileShader(fragmentShader);
+	checkShaderCompilation(fragmentShader);
+	glAttachShader(program, fragmentShader);
+	checkGLError();
+
+	glLinkProgram(program);
+	checkGLError();
+
+	return program;
+}
+
+static GLuint captureCreateTexture(GLenum internalFormat, int width, int height)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	checkGLError();
+	glBindTexture(GL_TEXTURE_2D, texture);
+	checkGLError();
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	checkGLError();
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	checkGLError();
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	checkGLError();
+
+	return texture;
+}
+
+// Leaves the framebuffer bound.
+static GLuint captureCreateFramebuffer(GLuint texture)
+{
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	checkGLError();
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	checkGLError();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	checkGLError();
+
+	return framebuffer;
+}
+#endif
+
+#ifdef CAPTURE_OFFSCREEN
+// The framebuffer holding the final frame, read back instead of the window.
+static GLuint captureFrameFramebuffer;
+#endif
+
+#ifdef CAPTURE_TILED
+#ifdef HAS_HOOK_RENDER
+#error Tiled capture only supports the default render path.
+#endif
+
+#define CAPTURE_RENDER_WIDTH (resolutionWidth * CAPTURE_SUPERSAMPLING)
+#define CAPTURE_RENDER_HEIGHT (resolutionHeight * CAPTURE_SUPERSAMPLING)
+
+// Supersampled frames without a tile size are rendered as a single tile.
+#if CAPTURE_TILE_SIZE > 0
+#define CAPTURE_TILE_WIDTH CAPTURE_TILE_SIZE
+#define CAPTURE_TILE_HEIGHT CAPTURE_TILE_SIZE
+#else
+#define CAPTURE_TILE_WIDTH CAPTURE_RENDER_WIDTH
+#define CAPTURE_TILE_HEIGHT CAPTURE_RENDER_HEIGHT
+#endif
+
+#define CAPTURE_STRINGIFY(x) #x
+#define CAPTURE_TO_STRING(x) CAPTURE_STRINGIFY(x)
+
+// Frames are rendered offscreen, as they may not fit in the window.
+static GLuint captureRenderFramebuffer;
+static GLuint captureRenderTexture;
+
+// The framebuffer holding the rendered frame at the capture resolution.
+static GLuint captureTiledFramebuffer;
+
+#if CAPTURE_SUPERSAMPLING > 1
+static GLuint captureResolveTexture;
+static GLint captureDownsampleProgram;
+
+// Box filter over the samples covered by each output pixel.
+static const char *captureDownsampleShaderCode =
+	"#version 130\n"
+	"#define S " CAPTURE_TO_STRING(CAPTURE_SUPERSAMPLING) "\n"
+	"uniform sampler2D f;"
+	"void main()"
+	"{"
+	"ivec2 p=ivec2(gl_FragCoord.xy)*S;"
+	"vec4 c=vec4(0.);"
+	"for(int y=0;y<S;++y)"
+	"for(int x=0;x<S;++x)"
+	"c+=texelFetch(f,p+ivec2(x,y),0);"
+	"gl_FragColor=c/float(S*S);"
+	"}";
+#endif
+
+// Renders the demo's pass as a grid of scissored tiles, each one flushed on its own,
+// so that no single draw covers the whole supersampled frame.
+static void captureRenderTiles()
+{
+	captureSaveState();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, captureRenderFramebuffer);
+	checkGLError();
+	glViewport(0, 0, CAPTURE_RENDER_WIDTH, CAPTURE_RENDER_HEIGHT);
+	checkGLError();
+	glUseProgram(captureProgramToRestore);
+	checkGLError();
+	glEnable(GL_SCISSOR_TEST);
+	checkGLError();
+
+	for (int y = 0; y < CAPTURE_RENDER_HEIGHT; y += CAPTURE_TILE_HEIGHT)
+	{
+		for (int x = 0; x < CAPTURE_RENDER_WIDTH; x += CAPTURE_TILE_WIDTH)
+		{
+			glScissor(x, y, CAPTURE_TILE_WIDTH, CAPTURE_TILE_HEIGHT);
+			checkGLError();
+			glRects(-1, -1, 1, 1);
+			checkGLError();
+			glFlush();
+		}
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+	checkGLError();
+
+#if CAPTURE_SUPERSAMPLING > 1
+	glBindFramebuffer(GL_FRAMEBUFFER, captureTiledFramebuffer);
+	checkGLError();
+	glViewport(0, 0, resolutionWidth, resolutionHeight);
+	checkGLError();
+	glBindTexture(GL_TEXTURE_2D, captureRenderTexture);
+	checkGLError();
+	glUseProgram(captureDownsampleProgram);
+	checkGLError();
+	glRects(-1, -1, 1, 1);
+	checkGLError();
+#endif
+
+	captureRestoreState();
+}
+#endif
+
+#if CAPTURE_SUBFRAME_COUNT > 1
+static GLuint captureSubframeTexture;
+static GLuint captureAccumulationTexture;
+static GLuint captureAccumulationFramebuffer;
+static GLuint captureBlurTexture;
+static GLint captureCopyProgram;
+
+static const char *captureCopyShaderCode =
+	"#version 130\n"
+	"uniform sampler2D f;"
+	"void main()"
+	"{"
+	"gl_FragColor=texelFetch(f,ivec2(gl_FragCoord.xy),0);"
+	"}";
+
+// Adds the rendered sub-frame to the float accumulation target, weighted by 1 / CAPTURE_SUBFRAME_COUNT.
+// The first sub-frame replaces the previous frame.
+static void captureAccumulateSubframe(int subframe)
+{
+	captureSaveState();
+
+#ifdef CAPTURE_TILED
+	glBindFramebuffer(GL_FRAMEBUFFER, captureTiledFramebuffer);
+	checkGLError();
+#endif
+
+	glBindTexture(GL_TEXTURE_2D, captureSubframeTexture);
+	checkGLError();
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, resolutionWidth, resolutionHeight);
+	checkGLError();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, captureAccumulationFramebuffer);
+	checkGLError();
+	glViewport(0, 0, resolutionWidth, resolutionHeight);
+	checkGLError();
+	glEnable(GL_BLEND);
+	checkGLError();
+	glBlendColor(0, 0, 0, 1.0f / CAPTURE_SUBFRAME_COUNT);
+	checkGLError();
+	glBlendFunc(GL_CONSTANT_ALPHA, subframe ? GL_ONE : GL_ZERO);
+	checkGLError();
+	glUseProgram(captureCopyProgram);
+	checkGLError();
+	glRects(-1, -1, 1, 1);
+	checkGLError();
+
+	captureRestoreState();
+}
+
+// Only the resolved frame is read back.
+static void captureResolveSubframes()
+{
+	captureSaveState();
+
+	glBindTexture(GL_TEXTURE_2D, captureAccumulationTexture);
+	checkGLError();
+	glBindFramebuffer(GL_FRAMEBUFFER, captureFrameFramebuffer);
+	checkGLError();
+	glViewport(0, 0, resolutionWidth, resolutionHeight);
+	checkGLError();
+	glUseProgram(captureCopyProgram);
+	checkGLError();
+	glRects(-1, -1, 1, 1);
+	checkGLError();
+
+	captureRestoreState();
 }
+#endif
+
+#ifdef CAPTURE_PIXEL_FORMAT_YUV420P
+static GLuint captureSourceTexture;
+static GLuint captureYuvTexture;
+static GLuint captureYuvFramebuffer;
+static GLint captureYuvProgram;
+
+// Packs the frame into planar YUV 4:2:0, BT.601 limited range, from top to bottom.
+// Each fragment outputs one byte of the frame, the chroma planes come after the luma plane.
+static const char *captureYuvShaderCode =
+	"#version 130\n"
+	"uniform sampler2D f;"
+	"void main()"
+	"{"
+	"ivec2 s=textureSize(f,0);"
+	"int i=int(gl_FragCoord.y)*s.x+int(gl_FragCoord.x),p=s.x*s.y;"
+	"if(i<p)"
+	"{"
+	"vec3 c=texelFetch(f,ivec2(i%s.x,s.y-1-i/s.x),0).rgb;"
+	"gl_FragColor=vec4((16.+dot(c,vec3(65.481,128.553,24.966)))/255.);"
+	"}"
+	"else"
+	"{"
+	"i-=p;"
+	"bool v=i>=p/4;"
+	"if(v)i-=p/4;"
+	// Sample at the center of each 2x2 block, the linear filter averages it.
+	"vec3 c=textureLod(f,vec2(2*(i%(s.x/2))+1,s.y-1-2*(i/(s.x/2)))/vec2(s),0.).rgb;"
+	"gl_FragColor=vec4((128.+dot(c,v?vec3(112.,-93.786,-18.214):vec3(-37.797,-74.203,112.)))/255.);"
+	"}"
+	"}";
+
+// Leaves the converted frame bound for reading.
+static void captureConvertToYuv()
+{
+	captureSaveState();
+
+	glBindTexture(GL_TEXTURE_2D, captureSourceTexture);
+	checkGLError();
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, resolutionWidth, resolutionHeight);
+	checkGLError();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, captureYuvFramebuffer);
+	checkGLError();
+	glViewport(0, 0, resolutionWidth, CAPTURE_READ_HEIGHT);
+	checkGLError();
+	glUseProgram(captureYuvProgram);
+	checkGLError();
+	glRects(-1, -1, 1, 1);
+	checkGLError();
+}
+#endif
+
+#if CAPTURE_WRITER_THREAD_COUNT > 0
+#ifndef HEADLESS
+#include <intrin.h>
+#endif
+
+#include "../engine/capture-writer.hpp"
+#endif
+
+#if CAPTURE_PBO_COUNT > 0
+// Frame n has been read into the pixel pack buffer n % CAPTURE_PBO_COUNT.
+// Mapping it waits for that readback only, later frames keep rendering.
+static void captureWritePbo(int n)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, framePbos[n % CAPTURE_PBO_COUNT]);
+	checkGLError();
+
+	const char *data = (const char *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	checkGLError();
+
+#if CAPTURE_WRITER_THREAD_COUNT > 0
+	char *buffer = captureWriterAcquire();
+	__movsb((unsigned char *)buffer, (const unsigned char *)data, CAPTURE_FRAME_SIZE);
+	captureWriterSubmit(n, buffer);
+#else
+	captureWriteFrame(n, data);
+#endif
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	checkGLError();
+}
+#endif
 
 #pragma hook initialize
 
-frameNumber = 0;
-frameBuffer = (char *)HeapAlloc(GetProcessHeap(), 0, resolutionWidth *resolutionHeight * 3 /* RGB8 */);
+{
+	float captureDuration =
+#ifdef DURATION
+		DURATION
+#else
+		REPLACE_HOOK_AUDIO_DURATION
+#endif
+		;
+
+	captureFrameCount = 0;
+	while ((float)captureFrameCount / CAPTURE_FPS < captureDuration)
+	{
+		++captureFrameCount;
+	}
+
+	// Segmented captures run one process per segment, given "<segment index> <segment count>".
+	// Resumed captures also give the first frame to render in the segment.
+	int arguments[3];
+	int argumentCount = commandLineReadIntegers(arguments, 3);
+	if (argumentCount >= 2 && arguments[0] >= 0 && arguments[0] < arguments[1])
+	{
+		captureStartFrame = captureFrameCount * arguments[0] / arguments[1];
+		captureEndFrame = captureFrameCount * (arguments[0] + 1) / arguments[1];
+	}
+	else
+	{
+		captureStartFrame = 0;
+		captureEndFrame = captureFrameCount;
+	}
+
+	frameNumber = captureStartFrame;
+	if (argumentCount == 3 && arguments[2] > captureStartFrame && arguments[2] < captureEndFrame)
+	{
+		frameNumber = arguments[2];
+	}
+
+	captureFirstFrame = frameNumber;
+
+	captureLog("capture range %d %d\n", captureStartFrame, captureEndFrame);
+}
+
+#ifndef CAPTURE_OUTPUT_PIPE
+captureManifestFile = CreateFile("frames.manifest", FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+// Resumed captures check that the frames were captured with the same settings.
+{
+	char line[64];
+	DWORD length = wsprintfA(line, "frames %d %d %d %d\n", captureFrameCount, CAPTURE_FPS, resolutionWidth, resolutionHeight);
+	WriteFile(captureManifestFile, line, length, &length, NULL);
+}
+#endif
+
+#ifdef CAPTURE_OUTPUT_STREAM
+// Segments write their own frames in the same file, which must not be truncated.
+frameFile = CreateFile("frames.raw", GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+// Reserve the whole capture on disk, the file size still grows frame by frame.
+FILE_ALLOCATION_INFO frameFileAllocation;
+frameFileAllocation.AllocationSize.QuadPart = UInt32x32To64(captureFrameCount, CAPTURE_FRAME_SIZE);
+SetFileInformationByHandle(frameFile, FileAllocationInfo, &frameFileAllocation, sizeof(frameFileAllocation));
+#elif defined(CAPTURE_OUTPUT_PIPE)
+frameFile = GetStdHandle(STD_OUTPUT_HANDLE);
+#endif
+
+#if CAPTURE_WRITER_THREAD_COUNT > 0
+captureWriterStart(captureWriteFrame);
+#endif
+
+glPixelStorei(GL_PACK_ALIGNMENT, 1);
+checkGLError();
+
+#ifdef CAPTURE_TILED
+captureRenderTexture = captureCreateTexture(GL_RGBA8, CAPTURE_RENDER_WIDTH, CAPTURE_RENDER_HEIGHT);
+captureRenderFramebuffer = captureCreateFramebuffer(captureRenderTexture);
+
+#if CAPTURE_SUPERSAMPLING > 1
+captureResolveTexture = captureCreateTexture(GL_RGBA8, resolutionWidth, resolutionHeight);
+captureTiledFramebuffer = captureCreateFramebuffer(captureResolveTexture);
+captureDownsampleProgram = captureCreateProgram(captureDownsampleShaderCode);
+#else
+captureTiledFramebuffer = captureRenderFramebuffer;
+#endif
+#endif
+
+#if CAPTURE_SUBFRAME_COUNT > 1
+captureSubframeTexture = captureCreateTexture(GL_RGBA8, resolutionWidth, resolutionHeight);
+captureAccumulationTexture = captureCreateTexture(GL_RGBA32F, resolutionWidth, resolutionHeight);
+captureAccumulationFramebuffer = captureCreateFramebuffer(captureAccumulationTexture);
+captureBlurTexture = captureCreateTexture(GL_RGBA8, resolutionWidth, resolutionHeight);
+captureFrameFramebuffer = captureCreateFramebuffer(captureBlurTexture);
+captureCopyProgram = captureCreateProgram(captureCopyShaderCode);
+#elif defined(CAPTURE_TILED)
+captureFrameFramebuffer = captureTiledFramebuffer;
+#endif
+
+#ifdef CAPTURE_OFFSCREEN
+glBindFramebuffer(GL_FRAMEBUFFER, 0);
+checkGLError();
+glBindTexture(GL_TEXTURE_2D, 0);
+checkGLError();
+#endif
+
+#ifdef CAPTURE_PIXEL_FORMAT_YUV420P
+captureSourceTexture = captureCreateTexture(GL_RGB8, resolutionWidth, resolutionHeight);
+captureYuvTexture = captureCreateTexture(GL_R8, resolutionWidth, CAPTURE_READ_HEIGHT);
+captureYuvFramebuffer = captureCreateFramebuffer(captureYuvTexture);
+glBindFramebuffer(GL_FRAMEBUFFER, 0);
+checkGLError();
+captureYuvProgram = captureCreateProgram(captureYuvShaderCode);
+#endif
+
+#if CAPTURE_PBO_COUNT > 0
+glGenBuffers(CAPTURE_PBO_COUNT, framePbos);
+checkGLError();
+
+for (int i = 0; i < CAPTURE_PBO_COUNT; ++i)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, framePbos[i]);
+	checkGLError();
+	glBufferData(GL_PIXEL_PACK_BUFFER, CAPTURE_FRAME_SIZE, NULL, GL_STREAM_READ);
+	checkGLError();
+}
+
+glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+checkGLError();
+#elif CAPTURE_WRITER_THREAD_COUNT == 0
+frameBuffer = (char *)HeapAlloc(GetProcessHeap(), 0, CAPTURE_FRAME_SIZE);
+#endif
 
 #pragma hook capture_time
 
+#if CAPTURE_SUBFRAME_COUNT > 1
+// Sub-frames are spread over the time the shutter is open, from the start of the frame.
+float time = (frameNumber + (subframe + 0.5f) * CAPTURE_SHUTTER_ANGLE / (360.0f * CAPTURE_SUBFRAME_COUNT)) / CAPTURE_FPS;
+#else
 float time = (float)frameNumber / CAPTURE_FPS;
+#endif
 
 #pragma hook capture_is_playing
 
-((float)frameNumber / CAPTURE_FPS) < REPLACE_HOOK_AUDIO_DURATION
+frameNumber < captureEndFrame
+
+#pragma hook capture_render
+
+#ifdef CAPTURE_TILED
+captureRenderTiles();
+#else
+glRects(-1, -1, 1, 1);
+checkGLError();
+#endif
+
+#pragma hook capture_accumulate
+
+#if CAPTURE_SUBFRAME_COUNT > 1
+captureAccumulateSubframe(subframe);
+#endif
 
 #pragma hook capture_frame
 
-	glReadPixels(0, 0, resolutionWidth, resolutionHeight, GL_RGB, GL_UNSIGNED_BYTE, frameBuffer);
-frameFile = CreateFile(frameFilename(frameNumber), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
-if (frameFile)
+#if CAPTURE_SUBFRAME_COUNT > 1
+captureResolveSubframes();
+#endif
+
+#ifdef CAPTURE_OFFSCREEN
+glBindFramebuffer(GL_FRAMEBUFFER, captureFrameFramebuffer);
+checkGLError();
+#endif
+
+#ifdef CAPTURE_PIXEL_FORMAT_YUV420P
+captureConvertToYuv();
+#endif
+
+#if CAPTURE_PBO_COUNT > 0
+// The slot of this frame still holds the frame CAPTURE_PBO_COUNT before.
+if (frameNumber - captureFirstFrame >= CAPTURE_PBO_COUNT)
 {
-	WriteFile(frameFile, frameBuffer, resolutionWidth * resolutionHeight * 3, &frameBytesWritten, NULL);
-	CloseHandle(frameFile);
+	captureWritePbo(frameNumber - CAPTURE_PBO_COUNT);
 }
+
+glBindBuffer(GL_PIXEL_PACK_BUFFER, framePbos[frameNumber % CAPTURE_PBO_COUNT]);
+checkGLError();
+glReadPixels(0, 0, resolutionWidth, CAPTURE_READ_HEIGHT, CAPTURE_READ_FORMAT, GL_UNSIGNED_BYTE, 0);
+checkGLError();
+glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+checkGLError();
+#elif CAPTURE_WRITER_THREAD_COUNT > 0
+frameBuffer = captureWriterAcquire();
+glReadPixels(0, 0, resolutionWidth, CAPTURE_READ_HEIGHT, CAPTURE_READ_FORMAT, GL_UNSIGNED_BYTE, frameBuffer);
+checkGLError();
+captureWriterSubmit(frameNumber, frameBuffer);
+#else
+glReadPixels(0, 0, resolutionWidth, CAPTURE_READ_HEIGHT, CAPTURE_READ_FORMAT, GL_UNSIGNED_BYTE, frameBuffer);
+captureWriteFrame(frameNumber, frameBuffer);
+#endif
+
+#ifdef CAPTURE_PIXEL_FORMAT_YUV420P
+captureRestoreState();
+#elif defined(CAPTURE_OFFSCREEN)
+glBindFramebuffer(GL_FRAMEBUFFER, 0);
+checkGLError();
+#endif
+
 frameNumber++;
+
+if (frameNumber % CAPTURE_FPS == 0)
+{
+	captureLog("capture progress %d\n", frameNumber);
+}
+
+#pragma hook capture_end
+
+#if CAPTURE_PBO_COUNT > 0
+// Drain the frames still in flight.
+for (int i = frameNumber - captureFirstFrame < CAPTURE_PBO_COUNT ? captureFirstFrame : frameNumber - CAPTURE_PBO_COUNT; i < frameNumber; ++i)
+{
+	captureWritePbo(i);
+}
+#endif
+
+#if CAPTURE_WRITER_THREAD_COUNT > 0
+captureWriterStop();
+#endif
+
+#if defined(CAPTURE_OUTPUT_STREAM) || defined(CAPTURE_OUTPUT_PIPE)
+CloseHandle(frameFile);
+#endif
+
+#ifndef CAPTURE_OUTPUT_PIPE
+CloseHandle(captureManifestFile);
+#endif
+
+captureLog("capture done %d\n", captureWrittenFrameCount);
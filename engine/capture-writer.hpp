@@ -0,0 +1,180 @@
+#pragma once
+
+// Writes captured frames from background threads.
+// The render thread takes a buffer from a preallocated pool, fills it, and
+// queues it for the writer threads, which give it back once written. Both
+// queues are lock-free; the render thread only waits when the pool is empty.
+//
+// Requires CAPTURE_FRAME_SIZE, CAPTURE_WRITER_BUFFER_COUNT,
+// CAPTURE_WRITER_QUEUE_SIZE (a power of two greater than the number of
+// buffers and threads) and CAPTURE_WRITER_THREAD_COUNT.
+
+struct CaptureWriterQueue
+{
+	struct Cell
+	{
+		volatile LONG sequence;
+		int frameNumber;
+		char *data;
+	};
+
+	Cell cells[CAPTURE_WRITER_QUEUE_SIZE];
+	volatile LONG pushPosition;
+	volatile LONG popPosition;
+
+	// Counts the cells ready to be popped.
+	HANDLE itemCount;
+};
+
+static CaptureWriterQueue captureWriterFreeQueue;
+static CaptureWriterQueue captureWriterFilledQueue;
+static HANDLE captureWriterThreads[CAPTURE_WRITER_THREAD_COUNT];
+static void (*captureWriterWrite)(int frameNumber, const char *data);
+
+static volatile LONG captureWriterQueueDepth;
+static LONG captureWriterMaxQueueDepth;
+static LONG captureWriterStallCount;
+static DWORD captureWriterStallDuration;
+static volatile LONG captureWriterFrameCount;
+static volatile LONGLONG captureWriterBytesWritten;
+
+static char captureWriterReport[256];
+
+static void captureWriterInitializeQueue(CaptureWriterQueue &queue)
+{
+	for (LONG i = 0; i < CAPTURE_WRITER_QUEUE_SIZE; ++i)
+	{
+		queue.cells[i].sequence = i;
+	}
+
+	queue.itemCount = CreateSemaphore(NULL, 0, CAPTURE_WRITER_QUEUE_SIZE, NULL);
+}
+
+// Queues never hold more items than their size, so pushing never fails.
+static void captureWriterPush(CaptureWriterQueue &queue, int frameNumber, char *data)
+{
+	LONG position = InterlockedIncrement(&queue.pushPosition) - 1;
+	CaptureWriterQueue::Cell &cell = queue.cells[position & (CAPTURE_WRITER_QUEUE_SIZE - 1)];
+
+	// The previous item in this cell may still be being popped.
+	while (cell.sequence != position)
+	{
+		YieldProcessor();
+	}
+
+	cell.frameNumber = frameNumber;
+	cell.data = data;
+	InterlockedExchange(&cell.sequence, position + 1);
+
+	ReleaseSemaphore(queue.itemCount, 1, NULL);
+}
+
+// The caller must have taken an item from queue.itemCount.
+static char *captureWriterPop(CaptureWriterQueue &queue, int &frameNumber)
+{
+	LONG position = InterlockedIncrement(&queue.popPosition) - 1;
+	CaptureWriterQueue::Cell &cell = queue.cells[position & (CAPTURE_WRITER_QUEUE_SIZE - 1)];
+
+	// The item has been counted but may not be published yet.
+	while (cell.sequence != position + 1)
+	{
+		YieldProcessor();
+	}
+
+	frameNumber = cell.frameNumber;
+	char *data = cell.data;
+	InterlockedExchange(&cell.sequence, position + CAPTURE_WRITER_QUEUE_SIZE);
+
+	return data;
+}
+
+static DWORD WINAPI captureWriterThread(LPVOID)
+{
+	for (;;)
+	{
+		WaitForSingleObject(captureWriterFilledQueue.itemCount, INFINITE);
+
+		int frameNumber;
+		char *data = captureWriterPop(captureWriterFilledQueue, frameNumber);
+		if (!data)
+		{
+			return 0;
+		}
+
+		InterlockedDecrement(&captureWriterQueueDepth);
+
+		captureWriterWrite(frameNumber, data);
+
+		InterlockedIncrement(&captureWriterFrameCount);
+		InterlockedExchangeAdd64(&captureWriterBytesWritten, CAPTURE_FRAME_SIZE);
+
+		captureWriterPush(captureWriterFreeQueue, 0, data);
+	}
+}
+
+static void captureWriterStart(void (*write)(int frameNumber, const char *data))
+{
+	captureWriterWrite = write;
+
+	captureWriterInitializeQueue(captureWriterFreeQueue);
+	captureWriterInitializeQueue(captureWriterFilledQueue);
+
+	for (int i = 0; i < CAPTURE_WRITER_BUFFER_COUNT; ++i)
+	{
+		captureWriterPush(captureWriterFreeQueue, 0, (char *)HeapAlloc(GetProcessHeap(), 0, CAPTURE_FRAME_SIZE));
+	}
+
+	for (int i = 0; i < CAPTURE_WRITER_THREAD_COUNT; ++i)
+	{
+		captureWriterThreads[i] = CreateThread(NULL, 0, captureWriterThread, NULL, 0, NULL);
+	}
+}
+
+// Returns a buffer of CAPTURE_FRAME_SIZE bytes to fill, then to give to captureWriterSubmit.
+static char *captureWriterAcquire()
+{
+	if (WaitForSingleObject(captureWriterFreeQueue.itemCount, 0) == WAIT_TIMEOUT)
+	{
+		// Every buffer is queued or being written: the disk does not keep up.
+		++captureWriterStallCount;
+		DWORD stallStart = GetTickCount();
+		WaitForSingleObject(captureWriterFreeQueue.itemCount, INFINITE);
+		captureWriterStallDuration += GetTickCount() - stallStart;
+	}
+
+	int unused;
+	return captureWriterPop(captureWriterFreeQueue, unused);
+}
+
+static void captureWriterSubmit(int frameNumber, char *data)
+{
+	LONG queueDepth = InterlockedIncrement(&captureWriterQueueDepth);
+	if (queueDepth > captureWriterMaxQueueDepth)
+	{
+		captureWriterMaxQueueDepth = queueDepth;
+	}
+
+	captureWriterPush(captureWriterFilledQueue, frameNumber, data);
+}
+
+// Waits for the queued frames to be written, then reports the counters on the standard error.
+static void captureWriterStop()
+{
+	for (int i = 0; i < CAPTURE_WRITER_THREAD_COUNT; ++i)
+	{
+		captureWriterPush(captureWriterFilledQueue, 0, NULL);
+	}
+
+	WaitForMultipleObjects(CAPTURE_WRITER_THREAD_COUNT, captureWriterThreads, TRUE, INFINITE);
+
+	DWORD reportLength = wsprintfA(
+		captureWriterReport,
+		"Capture writer: %d frames, %u MiB written, max queue depth %d/%d, %d stalls for %u ms.\n",
+		captureWriterFrameCount,
+		(DWORD)(captureWriterBytesWritten >> 20),
+		captureWriterMaxQueueDepth,
+		CAPTURE_WRITER_BUFFER_COUNT,
+		captureWriterStallCount,
+		captureWriterStallDuration);
+	WriteFile(GetStdHandle(STD_ERROR_HANDLE), captureWriterReport, reportLength, &reportLength, NULL);
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+// Shades only one pixel out of CHECKERBOARD_INTERLEAVE each frame, the others keep their value from the previous frames.
+// Pixels are skipped by the stencil test before the fragment shader runs.
+// There is no motion reprojection: the resolve only clamps the kept pixels to the range of their recently shaded
+// neighbours, which limits the trails of moving content, then writes the frame to the window.
+// Every pixel is shaded again on the first frame, when time goes back or jumps, and on cuts.
+//
+// The default render pass is wrapped automatically. Render hooks wrap their final pass themselves:
+//     checkerboardBegin(time);
+//     ...
+//     checkerboardEnd();
+// checkerboardEnd leaves its own program bound.
+
+#ifdef CHECKERBOARD
+
+#define CHECKERBOARD_STRINGIFY(x) #x
+#define CHECKERBOARD_TO_STRING(x) CHECKERBOARD_STRINGIFY(x)
+
+// Phase of each pixel, in the order pixels are shaded.
+// 2 is a checkerboard. 4 shades a 2x2 block in the order (0,0), (1,0), (1,1), (0,1):
+// consecutive phases alternate between the two diagonals, so phases of the same parity form a checkerboard.
+#define CHECKERBOARD_SHADER_PHASE                                    \
+	"#version 130\n"                                                 \
+	"#define N " CHECKERBOARD_TO_STRING(CHECKERBOARD_INTERLEAVE) "\n" \
+	"uniform int k;"                                                 \
+	"int v(ivec2 p)"                                                 \
+	"{"                                                              \
+	"return N==2?(p.x+p.y)&1:(p.x+p.y)&1|(p.y&1)*2;"                 \
+	"}"
+
+static const char *checkerboardMaskShaderCode =
+	CHECKERBOARD_SHADER_PHASE
+	"void main()"
+	"{"
+	"if(v(ivec2(gl_FragCoord.xy))!=k)discard;"
+	"}";
+
+// Pixels of the checkerboard shaded this frame are recent, which with 4 phases were also shaded two frames before.
+// k is negative when all of them are.
+static const char *checkerboardResolveShaderCode =
+	CHECKERBOARD_SHADER_PHASE
+	"uniform sampler2D f;"
+	"bool r(ivec2 p)"
+	"{"
+	"return k<0||((k^v(p))&1)==0;"
+	"}"
+	"void main()"
+	"{"
+	"ivec2 p=ivec2(gl_FragCoord.xy),s=textureSize(f,0)-1;"
+	"vec4 c=texelFetch(f,p,0);"
+	"if(!r(p))"
+	"{"
+	"vec4 a=vec4(1e9),b=vec4(-1e9);"
+	"for(int y=-1;y<2;++y)"
+	"for(int x=-1;x<2;++x)"
+	"{"
+	"ivec2 q=clamp(p+ivec2(x,y),ivec2(0),s);"
+	"if(r(q))"
+	"{"
+	"vec4 n=texelFetch(f,q,0);"
+	"a=min(a,n);"
+	"b=max(b,n);"
+	"}"
+	"}"
+	"c=clamp(c,a,b);"
+	"}"
+	"gl_FragColor=c;"
+	"}";
+
+#ifdef CHECKERBOARD_CUTS
+static const float checkerboardCuts[] = {CHECKERBOARD_CUTS};
+#endif
+
+static GLuint checkerboardFramebuffer;
+static GLuint checkerboardTexture;
+static GLint checkerboardResolveProgram;
+static GLint checkerboardResolvePhaseLocation;
+static int checkerboardFrameNumber;
+static int checkerboardPhase;
+static float checkerboardLastTime;
+
+static GLint checkerboardCreateProgram(const char *fragmentShaderCode)
+{
+	GLint program = glCreateProgram();
+	checkGLError();
+
+	GLint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	checkGLError();
+	glShaderSource(fragmentShader, 1, &fragmentShaderCode, 0);
+	checkGLError();
+	glCompileShader(fragmentShader);
+	checkShaderCompilation(fragmentShader);
+	glAttachShader(program, fragmentShader);
+	checkGLError();
+
+	glLinkProgram(program);
+	checkGLError();
+
+	return program;
+}
+
+// Leaves the stencil test disabled and no program bound.
+static void checkerboardInitialize(int width, int height)
+{
+	glGenTextures(1, &checkerboardTexture);
+	checkGLError();
+	glBindTexture(GL_TEXTURE_2D, checkerboardTexture);
+	checkGLError();
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	checkGLError();
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	checkGLError();
+
+	GLuint renderbuffer;
+	glGenRenderbuffers(1, &renderbuffer);
+	checkGLError();
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+	checkGLError();
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	checkGLError();
+
+	glGenFramebuffers(1, &checkerboardFramebuffer);
+	checkGLError();
+	glBindFramebuffer(GL_FRAMEBUFFER, checkerboardFramebuffer);
+	checkGLError();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, checkerboardTexture, 0);
+	checkGLError();
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffer);
+	checkGLError();
+
+	// The stencil buffer holds the phase of each pixel, it is written once.
+	glClear(GL_STENCIL_BUFFER_BIT);
+	checkGLError();
+	glEnable(GL_STENCIL_TEST);
+	checkGLError();
+	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	checkGLError();
+
+	GLint maskProgram = checkerboardCreateProgram(checkerboardMaskShaderCode);
+	glUseProgram(maskProgram);
+	checkGLError();
+	GLint maskPhaseLocation = glGetUniformLocation(maskProgram, "k");
+	checkGLError();
+
+	for (int phase = 1; phase < CHECKERBOARD_INTERLEAVE; ++phase)
+	{
+		glStencilFunc(GL_ALWAYS, phase, 0xff);
+		checkGLError();
+		glUniform1i(maskPhaseLocation, phase);
+		checkGLError();
+		glRects(-1, -1, 1, 1);
+		checkGLError();
+	}
+
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	checkGLError();
+	glDisable(GL_STENCIL_TEST);
+	checkGLError();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	checkGLError();
+	glUseProgram(0);
+	checkGLError();
+
+	checkerboardResolveProgram = checkerboardCreateProgram(checkerboardResolveShaderCode);
+	checkerboardResolvePhaseLocation = glGetUniformLocation(checkerboardResolveProgram, "k");
+	checkGLError();
+}
+
+static void checkerboardBegin(float time)
+{
+	bool full = checkerboardFrameNumber == 0 || time < checkerboardLastTime || time - checkerboardLastTime > CHECKERBOARD_MAX_TIME_STEP;
+
+#ifdef CHECKERBOARD_CUTS
+	for (auto cut : checkerboardCuts)
+	{
+		if (checkerboardLastTime < cut && cut <= time)
+		{
+			full = true;
+		}
+	}
+#endif
+
+	checkerboardLastTime = time;
+	checkerboardPhase = full ? -1 : checkerboardFrameNumber % CHECKERBOARD_INTERLEAVE;
+	++checkerboardFrameNumber;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, checkerboardFramebuffer);
+	checkGLError();
+
+	if (!full)
+	{
+		glEnable(GL_STENCIL_TEST);
+		checkGLError();
+		glStencilFunc(GL_EQUAL, checkerboardPhase, 0xff);
+		checkGLError();
+	}
+}
+
+// Restores the texture bound on the active unit, which the demo may sample in its next frame.
+static void checkerboardEnd()
+{
+	GLint textureToRestore;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &textureToRestore);
+	checkGLError();
+
+	glDisable(GL_STENCIL_TEST);
+	checkGLError();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	checkGLError();
+	glUseProgram(checkerboardResolveProgram);
+	checkGLError();
+	glUniform1i(checkerboardResolvePhaseLocation, checkerboardPhase);
+	checkGLError();
+	glBindTexture(GL_TEXTURE_2D, checkerboardTexture);
+	checkGLError();
+	glRects(-1, -1, 1, 1);
+	checkGLError();
+
+	glBindTexture(GL_TEXTURE_2D, textureToRestore);
+	checkGLError();
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+// Reads up to maxCount integers given on the command line after the executable path.
+// Returns how many have been read.
+static int commandLineReadIntegers(int *values, int maxCount)
+{
+	const char *ptr = GetCommandLineA();
+
+	if (*ptr == '"')
+	{
+		do
+		{
+			++ptr;
+		} while (*ptr && *ptr != '"');
+
+		if (*ptr)
+		{
+			++ptr;
+		}
+	}
+	else
+	{
+		while (*ptr && *ptr != ' ' && *ptr != '\t')
+		{
+			++ptr;
+		}
+	}
+
+	int count = 0;
+	while (count < maxCount)
+	{
+		while (*ptr == ' ' || *ptr == '\t')
+		{
+			++ptr;
+		}
+
+		bool negative = *ptr == '-';
+		if (negative)
+		{
+			++ptr;
+		}
+
+		if (*ptr < '0' || *ptr > '9')
+		{
+			break;
+		}
+
+		int value = 0;
+		while (*ptr >= '0' && *ptr <= '9')
+		{
+			value = value * 10 + (*ptr++ - '0');
+		}
+
+		values[count++] = negative ? -value : value;
+	}
+
+	return count;
+}
@@ -4,10 +4,37 @@
 
 #include <windows.h>
 
+#include <string.h>
+
 #include "demo.hpp"
 
 #include "debug.hpp"
 
+#define WGL_CONTEXT_FLAGS_ARB 0x2094
+#define WGL_CONTEXT_DEBUG_BIT_ARB 0x0001
+#define WGL_CONTEXT_PROFILE_MASK_ARB 0x9126
+#define WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB 0x0002
+
+typedef HGLRC(WINAPI *PFNWGLCREATECONTEXTATTRIBSARBPROC)(HDC hdc, HGLRC shareContext, const int *attributes);
+
+// Must be a power of two, so that positions wrap around evenly.
+#define DEBUG_MESSAGE_COUNT 256
+#define DEBUG_MESSAGE_LENGTH 512
+
+// The driver may call back from its own threads, so messages go through a bounded lock-free queue.
+// A slot is free for position p when its sequence is p, and filled when its sequence is p + 1.
+struct DebugMessage
+{
+	volatile LONG sequence;
+	GLenum source;
+	GLenum type;
+	GLuint id;
+	GLenum severity;
+	const char *filename;
+	int lineNumber;
+	char text[DEBUG_MESSAGE_LENGTH];
+};
+
 char debugBuffer[4096];
 
 HWND debugHwnd;
@@ -15,6 +42,16 @@ HWND debugHwnd;
 GLint debugFragmentShaders[PASS_COUNT];
 GLint debugVertexShaders[PASS_COUNT];
 
+static DebugMessage debugMessages[DEBUG_MESSAGE_COUNT];
+static volatile LONG debugMessageWritePosition;
+static LONG debugMessageReadPosition;
+static volatile LONG debugDroppedMessageCount;
+
+// Last call site checked on the render thread.
+// Messages are usually raised by the call which precedes it, but asynchronous ones may be late.
+static const char *volatile debugCallSiteFilename = "unknown";
+static volatile int debugCallSiteLineNumber;
+
 void APIENTRY showDebugMessageFromOpenGL(
 	GLenum source,
 	GLenum type,
@@ -24,23 +61,55 @@ void APIENTRY showDebugMessageFromOpenGL(
 	const GLchar *message,
 	const void *userParam)
 {
-#ifdef DEBUG_MESSAGE_BOX
-	// TODO : find better. This disable fullscreen, this is the only solution I found to display message box on top...
-	SetWindowPos(
-		debugHwnd, NULL, 1, 0,
-		width, height,
-		SWP_NOZORDER | SWP_NOACTIVATE | SWP_FRAMECHANGED);
-	MessageBox(debugHwnd, message, "Error", MB_OK | MB_TOPMOST | MB_SETFOREGROUND | MB_SYSTEMMODAL);
-#endif
+	LONG position = debugMessageWritePosition;
+	DebugMessage *slot;
+
+	for (;;)
+	{
+		slot = &debugMessages[position & (DEBUG_MESSAGE_COUNT - 1)];
+		LONG difference = slot->sequence - position;
+
+		if (difference == 0)
+		{
+			LONG previousPosition = InterlockedCompareExchange(&debugMessageWritePosition, position + 1, position);
+			if (previousPosition == position)
+			{
+				break;
+			}
+
+			position = previousPosition;
+		}
+		else if (difference < 0)
+		{
+			// Full until the next drain.
+			InterlockedIncrement(&debugDroppedMessageCount);
+			return;
+		}
+		else
+		{
+			position = debugMessageWritePosition;
+		}
+	}
 
-	std::cerr << "OpenGL debug message: ";
-	if (type == GL_DEBUG_TYPE_ERROR)
+	slot->source = source;
+	slot->type = type;
+	slot->id = id;
+	slot->severity = severity;
+	slot->filename = debugCallSiteFilename;
+	slot->lineNumber = debugCallSiteLineNumber;
+
+	if (length < 0)
+	{
+		length = (GLsizei)strlen(message);
+	}
+	if (length > DEBUG_MESSAGE_LENGTH - 1)
 	{
-		std::cerr << "** GL ERROR **";
+		length = DEBUG_MESSAGE_LENGTH - 1;
 	}
-	std::cerr << "type = 0x" << std::hex << type
-			  << ", severity = 0x" << std::hex << severity
-			  << ", message = " << message << std::endl;
+	memcpy(slot->text, message, length);
+	slot->text[length] = '\0';
+
+	InterlockedExchange(&slot->sequence, position + 1);
 }
 
 void APIENTRY showDebugMessage(const char *message)
@@ -48,8 +117,100 @@ void APIENTRY showDebugMessage(const char *message)
 	std::cerr << message << std::endl;
 }
 
+void debugCreateContext(HDC hdc)
+{
+	auto wglCreateContextAttribsARB = (PFNWGLCREATECONTEXTATTRIBSARBPROC)wglGetProcAddress("wglCreateContextAttribsARB");
+	if (!wglCreateContextAttribsARB)
+	{
+		showDebugMessage("WGL_ARB_create_context is not available, OpenGL debug messages may not be sent.");
+		return;
+	}
+
+	const int attributes[] = {
+		WGL_CONTEXT_FLAGS_ARB,
+		WGL_CONTEXT_DEBUG_BIT_ARB,
+		WGL_CONTEXT_PROFILE_MASK_ARB,
+		WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB,
+		0,
+	};
+
+	HGLRC context = wglCreateContextAttribsARB(hdc, NULL, attributes);
+	if (!context)
+	{
+		showDebugMessage("Debug context creation failed, OpenGL debug messages may not be sent.");
+		return;
+	}
+
+	HGLRC previousContext = wglGetCurrentContext();
+	wglMakeCurrent(hdc, context);
+	wglDeleteContext(previousContext);
+}
+
+void debugInitialize()
+{
+	for (LONG i = 0; i < DEBUG_MESSAGE_COUNT; ++i)
+	{
+		debugMessages[i].sequence = i;
+	}
+
+	if (!glDebugMessageCallback)
+	{
+		showDebugMessage("KHR_debug is not available, enable demo:checkGLError to check OpenGL errors.");
+		return;
+	}
+
+	// Not synchronous: the driver keeps running its own threads.
+	glEnable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(showDebugMessageFromOpenGL, NULL);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+}
+
+void debugDrainMessages()
+{
+	for (;;)
+	{
+		DebugMessage &slot = debugMessages[debugMessageReadPosition & (DEBUG_MESSAGE_COUNT - 1)];
+		if (slot.sequence != debugMessageReadPosition + 1)
+		{
+			break;
+		}
+
+#ifdef DEBUG_MESSAGE_BOX
+		// TODO : find better. This disable fullscreen, this is the only solution I found to display message box on top...
+		SetWindowPos(
+			debugHwnd, NULL, 1, 0,
+			width, height,
+			SWP_NOZORDER | SWP_NOACTIVATE | SWP_FRAMECHANGED);
+		MessageBox(debugHwnd, slot.text, "Error", MB_OK | MB_TOPMOST | MB_SETFOREGROUND | MB_SYSTEMMODAL);
+#endif
+
+		std::cerr << "OpenGL debug message after " << slot.filename << "@" << std::dec << slot.lineNumber << ": ";
+		if (slot.type == GL_DEBUG_TYPE_ERROR)
+		{
+			std::cerr << "** GL ERROR **";
+		}
+		std::cerr << "type = 0x" << std::hex << slot.type
+				  << ", severity = 0x" << std::hex << slot.severity
+				  << ", id = 0x" << std::hex << slot.id
+				  << ", message = " << slot.text << std::dec << std::endl;
+
+		InterlockedExchange(&slot.sequence, debugMessageReadPosition + DEBUG_MESSAGE_COUNT);
+		++debugMessageReadPosition;
+	}
+
+	LONG droppedMessageCount = InterlockedExchange(&debugDroppedMessageCount, 0);
+	if (droppedMessageCount)
+	{
+		std::cerr << droppedMessageCount << " OpenGL debug messages have been dropped." << std::endl;
+	}
+}
+
 void _checkGLError(const char *filename, int lineNumber)
 {
+	debugCallSiteFilename = filename;
+	debugCallSiteLineNumber = lineNumber;
+
+#ifdef DEBUG_CHECK_GL_ERROR
 	GLenum err = glGetError();
 	if (err != GL_NO_ERROR)
 	{
@@ -84,6 +245,7 @@ void _checkGLError(const char *filename, int lineNumber)
 	}
 
 	// ExitProcess(1);
+#endif
 }
 
 void checkShaderCompilation(GLint shader)
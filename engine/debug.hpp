@@ -22,9 +22,19 @@ void APIENTRY showDebugMessageFromOpenGL(
 
 void APIENTRY showDebugMessage(const char *message);
 
+// Replaces the current context by a debug one, in which KHR_debug messages are reliably sent.
+void debugCreateContext(HDC hdc);
+
+// Registers the debug message callback, must be called once GL functions are loaded.
+void debugInitialize();
+
+// Displays the debug messages received since the previous call, once per frame.
+void debugDrainMessages();
+
 void _checkGLError(const char *filename, int lineNumber);
 
-// This function can be called after a GL function to check whether an error has been raised.
+// This function can be called after a GL function to record the call site attached to debug messages.
+// With demo:checkGLError, it also checks whether an error has been raised, which stalls the driver.
 #define checkGLError() _checkGLError(__FILE__, __LINE__)
 
 void checkShaderCompilation(GLint shader);
@@ -34,5 +44,6 @@ void checkShaderCompilation(GLint shader);
 #define checkGLError()
 #define checkShaderCompilation(shader)
 #define showDebugMessage(...)
+#define debugDrainMessages()
 
 #endif
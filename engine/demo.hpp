@@ -2,7 +2,12 @@
 
 #include "../build/demo-data.hpp"
 
-#ifdef DEBUG
+#ifdef HEADLESS
+
+// Functions are linked directly, see headless.hpp.
+#define loadGLFunctions()
+
+#elif defined(DEBUG)
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -0,0 +1,157 @@
+#pragma once
+
+// Renders into an offscreen target whose size follows the measured GPU time, then upscales it to the window.
+// The scale goes down one level as soon as the budget is exceeded for some frames,
+// and up one level only when there is enough headroom for as long, so that it does not oscillate.
+//
+// The default render pass is wrapped automatically. Render hooks wrap their passes themselves:
+//     dynamicResolutionBegin();
+//     ...
+//     dynamicResolutionEnd();
+// Passes in between render at dynamicResolutionWidth x dynamicResolutionHeight.
+
+#ifdef DYNAMIC_RESOLUTION
+
+#define DYNAMIC_RESOLUTION_LEVEL_COUNT 16
+
+// Timer results are read as soon as they are available, which takes a few frames, so that the pipeline never stalls.
+// While all queries are pending, frames are not measured.
+#define DYNAMIC_RESOLUTION_QUERY_COUNT 4
+
+static int dynamicResolutionWindowWidth;
+static int dynamicResolutionWindowHeight;
+static int dynamicResolutionWidth;
+static int dynamicResolutionHeight;
+static int dynamicResolutionLevel = DYNAMIC_RESOLUTION_LEVEL_COUNT;
+static int dynamicResolutionSlowFrameCount;
+static int dynamicResolutionFastFrameCount;
+static GLuint dynamicResolutionFramebuffer;
+static GLuint dynamicResolutionQueries[DYNAMIC_RESOLUTION_QUERY_COUNT];
+static int dynamicResolutionOldestQuery;
+static int dynamicResolutionPendingQueryCount;
+static bool dynamicResolutionFrameMeasured;
+
+static void dynamicResolutionInitialize(int width, int height)
+{
+	dynamicResolutionWindowWidth = width;
+	dynamicResolutionWindowHeight = height;
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	checkGLError();
+	glBindTexture(GL_TEXTURE_2D, texture);
+	checkGLError();
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	checkGLError();
+
+	glGenFramebuffers(1, &dynamicResolutionFramebuffer);
+	checkGLError();
+	glBindFramebuffer(GL_FRAMEBUFFER, dynamicResolutionFramebuffer);
+	checkGLError();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	checkGLError();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	checkGLError();
+
+	glGenQueries(DYNAMIC_RESOLUTION_QUERY_COUNT, dynamicResolutionQueries);
+	checkGLError();
+}
+
+// Integer arithmetic only, timings are compared in nanoseconds.
+static void dynamicResolutionAdapt(GLuint elapsed)
+{
+	if (elapsed > DYNAMIC_RESOLUTION_BUDGET)
+	{
+		dynamicResolutionFastFrameCount = 0;
+		if (++dynamicResolutionSlowFrameCount >= DYNAMIC_RESOLUTION_DECREASE_FRAMES && dynamicResolutionLevel > DYNAMIC_RESOLUTION_MIN_LEVEL)
+		{
+			--dynamicResolutionLevel;
+			dynamicResolutionSlowFrameCount = 0;
+		}
+	}
+	else if (elapsed < DYNAMIC_RESOLUTION_HEADROOM)
+	{
+		dynamicResolutionSlowFrameCount = 0;
+		if (++dynamicResolutionFastFrameCount >= DYNAMIC_RESOLUTION_INCREASE_FRAMES && dynamicResolutionLevel < DYNAMIC_RESOLUTION_LEVEL_COUNT)
+		{
+			++dynamicResolutionLevel;
+			dynamicResolutionFastFrameCount = 0;
+		}
+	}
+	else
+	{
+		dynamicResolutionSlowFrameCount = 0;
+		dynamicResolutionFastFrameCount = 0;
+	}
+}
+
+static void dynamicResolutionBegin()
+{
+	// Results come in the order of the frames, a late one is waited for on the next frames rather than dropped.
+	while (dynamicResolutionPendingQueryCount)
+	{
+		GLuint query = dynamicResolutionQueries[dynamicResolutionOldestQuery];
+
+		GLuint available;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		checkGLError();
+		if (!available)
+		{
+			break;
+		}
+
+		GLuint elapsed;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &elapsed);
+		checkGLError();
+		dynamicResolutionAdapt(elapsed);
+
+		dynamicResolutionOldestQuery = (dynamicResolutionOldestQuery + 1) % DYNAMIC_RESOLUTION_QUERY_COUNT;
+		--dynamicResolutionPendingQueryCount;
+	}
+
+	dynamicResolutionWidth = dynamicResolutionWindowWidth * dynamicResolutionLevel / DYNAMIC_RESOLUTION_LEVEL_COUNT;
+	dynamicResolutionHeight = dynamicResolutionWindowHeight * dynamicResolutionLevel / DYNAMIC_RESOLUTION_LEVEL_COUNT;
+
+#ifdef uniformResolutionWidth
+	uniformResolutionWidth = (float)dynamicResolutionWidth;
+#endif
+
+#ifdef uniformResolutionHeight
+	uniformResolutionHeight = (float)dynamicResolutionHeight;
+#endif
+
+	glBindFramebuffer(GL_FRAMEBUFFER, dynamicResolutionFramebuffer);
+	checkGLError();
+	glViewport(0, 0, dynamicResolutionWidth, dynamicResolutionHeight);
+	checkGLError();
+
+	// A query is only reused once its result has been read.
+	dynamicResolutionFrameMeasured = dynamicResolutionPendingQueryCount < DYNAMIC_RESOLUTION_QUERY_COUNT;
+	if (dynamicResolutionFrameMeasured)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, dynamicResolutionQueries[(dynamicResolutionOldestQuery + dynamicResolutionPendingQueryCount) % DYNAMIC_RESOLUTION_QUERY_COUNT]);
+		checkGLError();
+	}
+}
+
+static void dynamicResolutionEnd()
+{
+	if (dynamicResolutionFrameMeasured)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		checkGLError();
+		++dynamicResolutionPendingQueryCount;
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	checkGLError();
+	glBlitFramebuffer(0, 0, dynamicResolutionWidth, dynamicResolutionHeight, 0, 0, dynamicResolutionWindowWidth, dynamicResolutionWindowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	checkGLError();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	checkGLError();
+	glViewport(0, 0, dynamicResolutionWindowWidth, dynamicResolutionWindowHeight);
+	checkGLError();
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+// Meshes which can not be computed from gl_VertexID and gl_InstanceID are uploaded once into immutable buffers,
+// so that nothing is transferred while rendering.
+// Include this file from the declarations hook, and add glCreateBuffers, glCreateVertexArrays,
+// glNamedBufferStorage and glVertexArrayElementBuffer to demo:gl:functions.
+//
+// The render_pass_N hook then draws elements from the element buffer of the vertex array,
+// with an offset instead of a pointer to client memory:
+//     glBindVertexArray(vertexArray);
+//     glDrawElements(GL_TRIANGLE_STRIP, count, GL_UNSIGNED_INT, 0);
+
+static GLuint geometryCreateBuffer(const void *data, GLsizeiptr size)
+{
+	GLuint buffer;
+	glCreateBuffers(1, &buffer);
+	checkGLError();
+	glNamedBufferStorage(buffer, size, data, 0);
+	checkGLError();
+
+	return buffer;
+}
+
+// Vertex attributes are then described with glVertexArrayVertexBuffer and glVertexArrayAttribFormat.
+static GLuint geometryCreateVertexArray(GLuint elementBuffer)
+{
+	GLuint vertexArray;
+	glCreateVertexArrays(1, &vertexArray);
+	checkGLError();
+	glVertexArrayElementBuffer(vertexArray, elementBuffer);
+	checkGLError();
+
+	return vertexArray;
+}
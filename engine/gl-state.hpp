@@ -0,0 +1,151 @@
+#pragma once
+
+// Shadow of the OpenGL state which render hooks change every frame.
+// Calls which would not change it are skipped, debug builds count them in glStateSkippedCallCount.
+//
+// Hooks call these functions instead of the OpenGL ones:
+//     glStateUseProgram(programs[1]);
+//     glStateBindFramebuffer(framebuffer);
+//     glStateBindTexture(0, texture);
+//     glStateBindVertexArray(vertexArray);
+//     glStateEnableBlend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// Code which changes this state with the OpenGL functions calls glStateInvalidate afterwards.
+
+#ifdef GL_STATE
+
+#define GL_STATE_TEXTURE_UNIT_COUNT 16
+
+// Never a valid name, nor a valid blend factor.
+#define GL_STATE_UNKNOWN 0xffffffff
+
+static GLuint glStateProgram;
+static GLuint glStateFramebuffer;
+static GLuint glStateVertexArray;
+static GLuint glStateTextureUnit;
+static GLuint glStateTextures[GL_STATE_TEXTURE_UNIT_COUNT];
+static GLuint glStateBlend;
+static GLenum glStateBlendSourceFactor;
+static GLenum glStateBlendDestinationFactor;
+
+#ifdef DEBUG
+static int glStateSkippedCallCount;
+#define GL_STATE_SKIP() ++glStateSkippedCallCount
+#else
+#define GL_STATE_SKIP()
+#endif
+
+static void glStateInvalidate()
+{
+	glStateProgram = GL_STATE_UNKNOWN;
+	glStateFramebuffer = GL_STATE_UNKNOWN;
+	glStateVertexArray = GL_STATE_UNKNOWN;
+	glStateTextureUnit = GL_STATE_UNKNOWN;
+	for (int i = 0; i < GL_STATE_TEXTURE_UNIT_COUNT; ++i)
+	{
+		glStateTextures[i] = GL_STATE_UNKNOWN;
+	}
+	glStateBlend = GL_STATE_UNKNOWN;
+	glStateBlendSourceFactor = GL_STATE_UNKNOWN;
+	glStateBlendDestinationFactor = GL_STATE_UNKNOWN;
+}
+
+static void glStateUseProgram(GLuint program)
+{
+	if (glStateProgram == program)
+	{
+		GL_STATE_SKIP();
+		return;
+	}
+
+	glStateProgram = program;
+	glUseProgram(program);
+	checkGLError();
+}
+
+static void glStateBindFramebuffer(GLuint framebuffer)
+{
+	if (glStateFramebuffer == framebuffer)
+	{
+		GL_STATE_SKIP();
+		return;
+	}
+
+	glStateFramebuffer = framebuffer;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	checkGLError();
+}
+
+static void glStateBindVertexArray(GLuint vertexArray)
+{
+	if (glStateVertexArray == vertexArray)
+	{
+		GL_STATE_SKIP();
+		return;
+	}
+
+	glStateVertexArray = vertexArray;
+	glBindVertexArray(vertexArray);
+	checkGLError();
+}
+
+// Binds a GL_TEXTURE_2D texture, the active unit is only changed when the binding changes.
+static void glStateBindTexture(GLuint unit, GLuint texture)
+{
+	if (glStateTextures[unit] == texture)
+	{
+		GL_STATE_SKIP();
+		return;
+	}
+
+	if (glStateTextureUnit != unit)
+	{
+		glStateTextureUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		checkGLError();
+	}
+
+	glStateTextures[unit] = texture;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	checkGLError();
+}
+
+static void glStateEnableBlend(GLenum sourceFactor, GLenum destinationFactor)
+{
+	if (glStateBlend == GL_TRUE)
+	{
+		GL_STATE_SKIP();
+	}
+	else
+	{
+		glStateBlend = GL_TRUE;
+		glEnable(GL_BLEND);
+		checkGLError();
+	}
+
+	if (glStateBlendSourceFactor == sourceFactor && glStateBlendDestinationFactor == destinationFactor)
+	{
+		GL_STATE_SKIP();
+	}
+	else
+	{
+		glStateBlendSourceFactor = sourceFactor;
+		glStateBlendDestinationFactor = destinationFactor;
+		glBlendFunc(sourceFactor, destinationFactor);
+		checkGLError();
+	}
+}
+
+static void glStateDisableBlend()
+{
+	if (glStateBlend == GL_FALSE)
+	{
+		GL_STATE_SKIP();
+		return;
+	}
+
+	glStateBlend = GL_FALSE;
+	glDisable(GL_BLEND);
+	checkGLError();
+}
+
+#endif
@@ -0,0 +1,399 @@
+#pragma once
+
+// Headless backend for Linux: renders with a surfaceless EGL context into an offscreen framebuffer,
+// which runs on Mesa's software rasterizer on machines without GPU.
+//
+// The few Win32 functions used by the engine and its hooks are implemented over POSIX,
+// with the behavior these uses rely on only: WaitForSingleObject waits on semaphores,
+// WaitForMultipleObjects joins threads, file handles are file descriptors.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// Shims are only defined for the features which use them, so that builds stay free of unused functions.
+#include "../build/demo-data.hpp"
+
+#define WINAPI
+
+typedef int BOOL;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef int64_t LONGLONG;
+typedef void *HANDLE;
+typedef void *LPVOID;
+typedef DWORD *LPDWORD;
+typedef DWORD(WINAPI *LPTHREAD_START_ROUTINE)(LPVOID);
+
+typedef union
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef union
+{
+	struct
+	{
+		DWORD LowPart;
+		DWORD HighPart;
+	};
+	uint64_t QuadPart;
+} ULARGE_INTEGER;
+
+typedef struct
+{
+	DWORD Offset;
+	DWORD OffsetHigh;
+	HANDLE hEvent;
+} OVERLAPPED;
+
+typedef struct
+{
+	LARGE_INTEGER AllocationSize;
+} FILE_ALLOCATION_INFO;
+
+enum
+{
+	FileAllocationInfo = 5,
+};
+
+#define FALSE 0
+#define TRUE 1
+
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+#define GENERIC_WRITE 0x40000000
+#define FILE_APPEND_DATA 0x0004
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+
+#define STD_OUTPUT_HANDLE ((DWORD)-11)
+#define STD_ERROR_HANDLE ((DWORD)-12)
+
+#define VK_ESCAPE 0x1B
+#define GetAsyncKeyState(key) 0
+#define ShowCursor(show)
+
+#define UInt32x32To64(a, b) ((uint64_t)(DWORD)(a) * (uint64_t)(DWORD)(b))
+
+// Interlocked functions are full barriers.
+#define InterlockedIncrement(target) __atomic_add_fetch((target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(target) __atomic_sub_fetch((target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchange(target, value) __atomic_exchange_n((target), (value), __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd64(target, value) __atomic_fetch_add((target), (value), __ATOMIC_SEQ_CST)
+#define YieldProcessor() sched_yield()
+
+#if defined(CAPTURE) && !defined(CAPTURE_OUTPUT_PIPE)
+#define CreateFile CreateFileA
+
+static HANDLE CreateFileA(const char *name, DWORD access, DWORD, void *, DWORD disposition, DWORD, HANDLE)
+{
+	int flags = O_WRONLY | O_CREAT;
+	if (access & FILE_APPEND_DATA)
+	{
+		flags |= O_APPEND;
+	}
+
+	switch (disposition)
+	{
+	case CREATE_NEW:
+		flags |= O_EXCL;
+		break;
+
+	case CREATE_ALWAYS:
+		flags |= O_TRUNC;
+		break;
+	}
+
+	return (HANDLE)(intptr_t)open(name, flags, 0644);
+}
+#endif
+
+// Captures and benchmarks report on the standard error.
+#if defined(CAPTURE) || defined(BENCHMARK)
+static BOOL WriteFile(HANDLE file, const void *data, DWORD size, LPDWORD bytesWritten, OVERLAPPED *overlapped)
+{
+	int fd = (int)(intptr_t)file;
+	ssize_t result;
+
+	// Positioned writes do not move the file offset, as on Windows.
+	if (overlapped)
+	{
+		off_t offset = (off_t)overlapped->Offset | ((off_t)overlapped->OffsetHigh << 32);
+		result = pwrite(fd, data, size, offset);
+	}
+	else
+	{
+		result = write(fd, data, size);
+	}
+
+	*bytesWritten = result < 0 ? 0 : (DWORD)result;
+	return result >= 0;
+}
+
+static HANDLE GetStdHandle(DWORD handle)
+{
+	return (HANDLE)(intptr_t)(handle == STD_OUTPUT_HANDLE ? STDOUT_FILENO : STDERR_FILENO);
+}
+#endif
+
+#ifdef CAPTURE
+static BOOL CloseHandle(HANDLE file)
+{
+	return close((int)(intptr_t)file) == 0;
+}
+#endif
+
+#ifdef CAPTURE_OUTPUT_STREAM
+// Reserves the space on disk without changing the file size.
+static BOOL SetFileInformationByHandle(HANDLE file, int, void *information, DWORD)
+{
+	FILE_ALLOCATION_INFO *allocation = (FILE_ALLOCATION_INFO *)information;
+	return fallocate((int)(intptr_t)file, FALLOC_FL_KEEP_SIZE, 0, allocation->AllocationSize.QuadPart) == 0;
+}
+#endif
+
+#define GetProcessHeap() NULL
+#define HeapAlloc(heap, flags, size) malloc(size)
+
+static inline void __movsb(unsigned char *destination, const unsigned char *source, size_t size)
+{
+	memcpy(destination, source, size);
+}
+
+#if CAPTURE_WRITER_THREAD_COUNT > 0
+static HANDLE CreateSemaphore(void *, LONG initialCount, LONG, const char *)
+{
+	sem_t *semaphore = (sem_t *)malloc(sizeof(sem_t));
+	sem_init(semaphore, 0, initialCount);
+	return semaphore;
+}
+
+static BOOL ReleaseSemaphore(HANDLE semaphore, LONG count, LONG *)
+{
+	while (count-- > 0)
+	{
+		sem_post((sem_t *)semaphore);
+	}
+	return TRUE;
+}
+
+static DWORD WaitForSingleObject(HANDLE semaphore, DWORD milliseconds)
+{
+	if (milliseconds == 0)
+	{
+		return sem_trywait((sem_t *)semaphore) == 0 ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+	}
+
+	while (sem_wait((sem_t *)semaphore) != 0 && errno == EINTR)
+	{
+	}
+	return WAIT_OBJECT_0;
+}
+
+struct HeadlessThread
+{
+	pthread_t thread;
+	LPTHREAD_START_ROUTINE routine;
+	LPVOID parameter;
+};
+
+static void *headlessThreadMain(void *thread)
+{
+	HeadlessThread *headlessThread = (HeadlessThread *)thread;
+	return (void *)(intptr_t)headlessThread->routine(headlessThread->parameter);
+}
+
+static HANDLE CreateThread(void *, size_t, LPTHREAD_START_ROUTINE routine, LPVOID parameter, DWORD, DWORD *)
+{
+	HeadlessThread *thread = (HeadlessThread *)malloc(sizeof(HeadlessThread));
+	thread->routine = routine;
+	thread->parameter = parameter;
+	pthread_create(&thread->thread, NULL, headlessThreadMain, thread);
+	return thread;
+}
+
+static DWORD WaitForMultipleObjects(DWORD count, const HANDLE *threads, BOOL, DWORD)
+{
+	for (DWORD i = 0; i < count; ++i)
+	{
+		pthread_join(((HeadlessThread *)threads[i])->thread, NULL);
+	}
+	return WAIT_OBJECT_0;
+}
+
+static DWORD GetTickCount()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (DWORD)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+#endif
+
+// Used by the benchmark, and by the realtime synthesizer when the demo plays.
+#if defined(BENCHMARK) || (!defined(CAPTURE) && defined(HAS_HOOK_AUDIO_START))
+static BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency)
+{
+	frequency->QuadPart = 1000000000;
+	return TRUE;
+}
+
+static BOOL QueryPerformanceCounter(LARGE_INTEGER *counter)
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	counter->QuadPart = (LONGLONG)now.tv_sec * 1000000000 + now.tv_nsec;
+	return TRUE;
+}
+#endif
+
+#define wsprintfA sprintf
+#define wvsprintfA vsprintf
+
+#ifdef CAPTURE
+// Rebuilds the command line from the arguments, only the executable path is quoted.
+static const char *GetCommandLineA()
+{
+	static char commandLine[4096];
+
+	FILE *file = fopen("/proc/self/cmdline", "rb");
+	if (!file)
+	{
+		return "\"\"";
+	}
+
+	size_t length = fread(commandLine + 1, 1, sizeof(commandLine) - 3, file);
+	fclose(file);
+
+	commandLine[0] = '"';
+	bool executable = true;
+	for (size_t i = 1; i <= length; ++i)
+	{
+		if (commandLine[i] == 0)
+		{
+			commandLine[i] = executable ? '"' : ' ';
+			executable = false;
+		}
+	}
+	commandLine[length + 1] = 0;
+
+	return commandLine;
+}
+#endif
+
+#define ExitProcess exit
+
+static GLuint headlessFramebuffer;
+
+static void headlessFail(const char *message)
+{
+	fprintf(stderr, "Headless: %s\n", message);
+	exit(1);
+}
+
+// Creates a desktop OpenGL compatibility context without any surface,
+// then a framebuffer of the demo's resolution which stands for the window's.
+static void headlessCreateContext(int width, int height)
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (eglGetPlatformDisplayEXT)
+	{
+		display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (display == EGL_NO_DISPLAY)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	if (!eglInitialize(display, NULL, NULL))
+	{
+		headlessFail("cannot initialize EGL.");
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		headlessFail("desktop OpenGL is not available.");
+	}
+
+	// No surface is created, so any surface type fits.
+	static const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE,
+		EGL_OPENGL_BIT,
+		EGL_SURFACE_TYPE,
+		0,
+		EGL_NONE,
+	};
+
+	EGLConfig config;
+	EGLint configCount;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+	{
+		headlessFail("no EGL config supports desktop OpenGL.");
+	}
+
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+	if (context == EGL_NO_CONTEXT)
+	{
+		headlessFail("cannot create the OpenGL context.");
+	}
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		headlessFail("cannot make the OpenGL context current, surfaceless contexts are not supported.");
+	}
+
+	GLuint renderbuffers[2];
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &headlessFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, headlessFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		headlessFail("cannot create the framebuffer.");
+	}
+
+	glViewport(0, 0, width, height);
+}
+
+// Binding the framebuffer 0 binds the one standing for the window.
+#define glBindFramebuffer(target, framebuffer) glBindFramebuffer((target), (framebuffer) ? (framebuffer) : headlessFramebuffer)
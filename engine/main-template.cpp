@@ -1,11 +1,23 @@
+#ifdef HEADLESS
+#include "../engine/headless.hpp"
+#else
 #define WIN32_LEAN_AND_MEAN
 #define WIN32_EXTRA_LEAN
 #include <windows.h>
+#endif
 
 #include "../engine/demo.hpp"
 
 #include "../engine/debug.hpp"
+#include "../engine/program-cache.hpp"
+#include "../engine/profiler.hpp"
+#include "../engine/dynamic-resolution.hpp"
+#include "../engine/checkerboard.hpp"
+#include "../engine/uniform-block.hpp"
+#include "../engine/gl-state.hpp"
+#ifndef HEADLESS
 #include "../engine/window.hpp"
+#endif
 
 #ifdef SERVER
 #include "../engine/server.hpp"
@@ -15,8 +27,15 @@
 REPLACE_HOOK_DECLARATIONS
 #endif
 
+// Reads the sound buffer declared by the audio hooks.
+#include "../engine/audio-analysis.hpp"
+
 #pragma code_seg(".main")
+#ifdef HEADLESS
+int main()
+#else
 void main()
+#endif
 {
 #ifndef FORCE_RESOLUTION
 	int resolutionWidth = GetSystemMetrics(SM_CXSCREEN);
@@ -37,6 +56,9 @@ void main()
 
 #endif
 
+#ifdef HEADLESS
+	headlessCreateContext(resolutionWidth, resolutionHeight);
+#else
 	auto hwnd = CreateWindowA("static", NULL, WS_POPUP | WS_VISIBLE, 0, 0, resolutionWidth, resolutionHeight, NULL, NULL, NULL, 0);
 	auto hdc = GetDC(hwnd);
 	SetPixelFormat(hdc, ChoosePixelFormat(hdc, &pfd), &pfd);
@@ -45,10 +67,12 @@ void main()
 
 #ifdef DEBUG
 	debugHwnd = hwnd;
+	debugCreateContext(hdc);
 #endif
 
 #ifdef LOADING_BLACK_SCREEN
 	wglSwapLayerBuffers(hdc, WGL_SWAP_MAIN_PLANE);
+#endif
 #endif
 
 	loadGLFunctions();
@@ -59,19 +83,19 @@ void main()
 	// std::cout << "OpenGL extensions: " << glGetString(GL_EXTENSIONS) << std::endl;
 	std::cout << std::endl;
 
-	//TODO : here we set a callback function for GL to use when an error is encountered. Does not seem to work !
-	/*
-	glEnable(GL_DEBUG_OUTPUT);
-	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-	glDebugMessageCallback(showDebugMessageFromOpenGL, NULL);
-	glDebugMessageControl(
-		GL_DONT_CARE,
-		GL_DONT_CARE,
-		GL_DONT_CARE,
-		0,
-		0,
-		true);
-		*/
+	debugInitialize();
+#endif
+
+#ifdef PROFILE
+	profilerInitialize();
+#endif
+
+#ifdef DYNAMIC_RESOLUTION
+	dynamicResolutionInitialize(resolutionWidth, resolutionHeight);
+#endif
+
+#ifdef CHECKERBOARD
+	checkerboardInitialize(resolutionWidth, resolutionHeight);
 #endif
 
 #ifdef SERVER
@@ -99,8 +123,10 @@ void main()
 
 	GLint vertexShader = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vertexShader, sizeof(vertexShaderSources) / sizeof(vertexShaderSources[0]), vertexShaderSources, 0);
+#ifndef PROGRAM_CACHE
 	glCompileShader(vertexShader);
 	checkShaderCompilation(vertexShader);
+#endif
 	glAttachShader(program, vertexShader);
 #endif
 
@@ -120,12 +146,19 @@ void main()
 
 	GLint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 	glShaderSource(fragmentShader, sizeof(fragmentShaderSources) / sizeof(fragmentShaderSources[0]), fragmentShaderSources, 0);
+#ifndef PROGRAM_CACHE
 	glCompileShader(fragmentShader);
 	checkShaderCompilation(fragmentShader);
+#endif
 	glAttachShader(program, fragmentShader);
 #endif
 
+#ifdef PROGRAM_CACHE
+	programCacheLink(program);
+	programCacheFinish(program);
+#else
 	glLinkProgram(program);
+#endif
 	checkGLError();
 
 #ifdef DEBUG
@@ -144,6 +177,17 @@ void main()
 #else
 	GLint programs[PASS_COUNT];
 
+	// Let the driver compile on as many threads as it wants.
+	// Loaded GL functions are macros, this one is missing from old GLEW versions and headless builds.
+#if defined(PARALLEL_SHADER_COMPILE) && defined(glMaxShaderCompilerThreadsKHR)
+	if (glMaxShaderCompilerThreadsKHR)
+	{
+		glMaxShaderCompilerThreadsKHR(0xffffffff);
+		checkGLError();
+	}
+#endif
+
+	// Every program is submitted before any result is queried, so that the driver can overlap their compilations.
 	for (auto i = 0; i < PASS_COUNT; ++i)
 	{
 		programs[i] = glCreateProgram();
@@ -168,9 +212,10 @@ void main()
 			checkGLError();
 			glShaderSource(vertexShader, sizeof(vertexShaderSources) / sizeof(vertexShaderSources[0]), vertexShaderSources, 0);
 			checkGLError();
+#ifndef PROGRAM_CACHE
 			glCompileShader(vertexShader);
 			checkGLError();
-			checkShaderCompilation(vertexShader);
+#endif
 			glAttachShader(programs[i], vertexShader);
 			checkGLError();
 
@@ -198,8 +243,10 @@ void main()
 			checkGLError();
 			glShaderSource(fragmentShader, sizeof(fragmentShaderSources) / sizeof(fragmentShaderSources[0]), fragmentShaderSources, 0);
 			checkGLError();
+#ifndef PROGRAM_CACHE
 			glCompileShader(fragmentShader);
-			checkShaderCompilation(fragmentShader);
+			checkGLError();
+#endif
 			glAttachShader(programs[i], fragmentShader);
 			checkGLError();
 
@@ -208,8 +255,29 @@ void main()
 #endif
 		}
 
+#ifdef PROGRAM_CACHE
+		programCacheLink(programs[i]);
+#else
 		glLinkProgram(programs[i]);
+#endif
 		checkGLError();
+	}
+
+	for (auto i = 0; i < PASS_COUNT; ++i)
+	{
+#ifdef PROGRAM_CACHE
+		programCacheFinish(programs[i]);
+#elif defined(DEBUG)
+		if (debugVertexShaders[i])
+		{
+			checkShaderCompilation(debugVertexShaders[i]);
+		}
+
+		if (debugFragmentShaders[i])
+		{
+			checkShaderCompilation(debugFragmentShaders[i]);
+		}
+#endif
 
 #ifdef DEBUG
 		std::cout << "Uniform locations in pass " << i << ":" << std::endl;
@@ -223,60 +291,224 @@ void main()
 	}
 #endif
 
+#ifdef UNIFORM_BLOCK
+	uniformBlockInitialize();
+#endif
+
 #ifdef SERVER
 	serverStart(startServerOptions);
 #endif
 
+#ifdef AUDIO_ANALYSIS
+#if defined(CAPTURE) && defined(HAS_HOOK_AUDIO_RENDER)
+	// Captures do not play the song, it is synthesized before the first frame is analyzed.
+	REPLACE_HOOK_AUDIO_RENDER
+#endif
+
+#if PASS_COUNT == 1
+	audioAnalysisInitialize(&program, 1);
+#else
+	audioAnalysisInitialize(programs, PASS_COUNT);
+#endif
+#endif
+
 #ifdef HAS_HOOK_INITIALIZE
 	REPLACE_HOOK_INITIALIZE
 #endif
 
-#if !defined(CAPTURE) && defined(HAS_HOOK_AUDIO_START)
+#ifdef GL_STATE
+	glStateInvalidate();
+#endif
+
+#if !defined(CAPTURE) && !defined(BENCHMARK) && defined(HAS_HOOK_AUDIO_START)
 	REPLACE_HOOK_AUDIO_START
 #endif
 
+#if !defined(CAPTURE) && !defined(BENCHMARK) && defined(HAS_HOOK_AUDIO_LOADING_PROGRESS)
+	// The playback waits for the synthesizer, a loading hook or a bar displays its progress meanwhile.
+	GLint loadingProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &loadingProgram);
+	checkGLError();
+	glUseProgram(0);
+	checkGLError();
+
+	for (;;)
+	{
+		float loadingProgress = REPLACE_HOOK_AUDIO_LOADING_PROGRESS;
+		if (loadingProgress >= 1.0f)
+		{
+			break;
+		}
+
+#ifndef HEADLESS
+		PeekMessage(NULL, NULL, 0, 0, PM_REMOVE);
+		if (GetAsyncKeyState(VK_ESCAPE))
+		{
+			ExitProcess(0);
+		}
+#endif
+
+#ifdef HAS_HOOK_LOADING
+		REPLACE_HOOK_LOADING
+#else
+		glClear(GL_COLOR_BUFFER_BIT);
+		checkGLError();
+		glRectf(-1.0f, -0.01f, loadingProgress * 2.0f - 1.0f, 0.01f);
+		checkGLError();
+#endif
+
+		debugDrainMessages();
+
+#ifndef HEADLESS
+		wglSwapLayerBuffers(hdc, WGL_SWAP_MAIN_PLANE);
+#endif
+	}
+
+	glUseProgram(loadingProgram);
+	checkGLError();
+#endif
+
+#if !defined(CAPTURE) && !defined(BENCHMARK) && defined(HAS_HOOK_AUDIO_PLAY)
+	REPLACE_HOOK_AUDIO_PLAY
+#endif
+
+// Without a hook telling whether the demo is playing, it plays for DURATION.
+#if defined(CLOSE_WHEN_FINISHED) && defined(DURATION) && !defined(HAS_HOOK_CAPTURE_IS_PLAYING) && !defined(HAS_HOOK_BENCHMARK_IS_PLAYING)
+#define PLAYING_UNTIL_DURATION
+
+	// The time is declared in the loop body, out of reach of the loop condition.
+	float lastTime;
+#endif
+
 	do
 	{
+#ifndef HEADLESS
 		// Avoid 'not responding' system messages.
 		PeekMessage(NULL, NULL, 0, 0, PM_REMOVE);
+#endif
+
+#ifdef PROFILE
+		profilerBeginFrame();
+#endif
+
+#if CAPTURE_SUBFRAME_COUNT > 1
+		for (int subframe = 0; subframe < CAPTURE_SUBFRAME_COUNT; ++subframe)
+		{
+#endif
 
 #ifdef HAS_HOOK_TIME
 		REPLACE_HOOK_TIME
 #elif defined(HAS_HOOK_CAPTURE_TIME)
 		REPLACE_HOOK_CAPTURE_TIME
+#elif defined(HAS_HOOK_BENCHMARK_TIME)
+		REPLACE_HOOK_BENCHMARK_TIME
 #elif defined(HAS_HOOK_AUDIO_TIME)
 		REPLACE_HOOK_AUDIO_TIME
 #endif
 
+#ifdef PLAYING_UNTIL_DURATION
+		lastTime = time;
+#endif
+
+#ifdef AUDIO_ANALYSIS
+		audioAnalysisUpdate(time);
+#endif
+
 #ifdef HAS_HOOK_RENDER
 		REPLACE_HOOK_RENDER
 #else
+		PROFILE_BEGIN("render");
+
+#ifdef DYNAMIC_RESOLUTION
+		dynamicResolutionBegin();
+#endif
+
+#ifdef CHECKERBOARD
+		checkerboardBegin(time);
+#endif
+
 #ifdef uniformTime
 		uniformTime = time;
 #endif
 
+#ifdef UNIFORM_BLOCK
+		uniformBlockUpdate();
+#else
 		glUniform1fv(0, FLOAT_UNIFORM_COUNT, floatUniforms);
 		checkGLError();
+#endif
 
+#ifdef HAS_HOOK_CAPTURE_RENDER
+		REPLACE_HOOK_CAPTURE_RENDER
+#else
 		glRects(-1, -1, 1, 1);
 		checkGLError();
 #endif
 
+#ifdef CHECKERBOARD
+		checkerboardEnd();
+#if PASS_COUNT == 1
+		glUseProgram(program);
+#else
+		glUseProgram(programs[PASS_COUNT - 1]);
+#endif
+		checkGLError();
+#endif
+
+#ifdef DYNAMIC_RESOLUTION
+		dynamicResolutionEnd();
+#endif
+
+		PROFILE_END();
+#endif
+
+#ifdef HAS_HOOK_CAPTURE_ACCUMULATE
+		REPLACE_HOOK_CAPTURE_ACCUMULATE
+#endif
+
+#if defined(GL_STATE) && defined(HAS_HOOK_CAPTURE_ACCUMULATE)
+		glStateInvalidate();
+#endif
+
+#if CAPTURE_SUBFRAME_COUNT > 1
+		}
+#endif
+
 #ifdef HAS_HOOK_CAPTURE_FRAME
+		PROFILE_BEGIN("capture");
 		REPLACE_HOOK_CAPTURE_FRAME
+		PROFILE_END();
+#endif
+
+#if defined(GL_STATE) && defined(HAS_HOOK_CAPTURE_FRAME)
+		glStateInvalidate();
+#endif
+
+#ifdef HAS_HOOK_BENCHMARK_FRAME
+		REPLACE_HOOK_BENCHMARK_FRAME
+#endif
+
+#ifdef PROFILE
+		profilerEndFrame();
 #endif
 
 #ifdef SERVER
 		serverUpdate();
 #endif
 
+		debugDrainMessages();
+
+#if !defined(HEADLESS) && !defined(BENCHMARK)
 		wglSwapLayerBuffers(hdc, WGL_SWAP_MAIN_PLANE);
+#endif
 	} while (
 #if defined(CLOSE_WHEN_FINISHED)
-#ifdef DURATION
-		time <= DURATION
-#elif defined(HAS_HOOK_CAPTURE_IS_PLAYING)
+#ifdef HAS_HOOK_CAPTURE_IS_PLAYING
 		REPLACE_HOOK_CAPTURE_IS_PLAYING
+#elif defined(HAS_HOOK_BENCHMARK_IS_PLAYING)
+		REPLACE_HOOK_BENCHMARK_IS_PLAYING
+#elif defined(PLAYING_UNTIL_DURATION)
+		lastTime <= DURATION
 #elif defined(HAS_HOOK_AUDIO_IS_PLAYING)
 		REPLACE_HOOK_AUDIO_IS_PLAYING
 #else
@@ -286,9 +518,23 @@ void main()
 #endif
 		!GetAsyncKeyState(VK_ESCAPE));
 
+#ifdef HAS_HOOK_CAPTURE_END
+	REPLACE_HOOK_CAPTURE_END
+#endif
+
+#ifdef PROFILE
+	profilerWrite();
+#endif
+
 #ifdef SERVER
 	serverStop();
 #endif
 
+#if defined(GL_STATE) && defined(DEBUG)
+	std::cerr << glStateSkippedCallCount << " redundant OpenGL calls have been skipped." << std::endl;
+#endif
+
+	debugDrainMessages();
+
 	ExitProcess(0);
 }
@@ -0,0 +1,270 @@
+#pragma once
+
+// Measures the GPU time of named scopes with timestamp queries.
+// Queries of up to PROFILE_LATENCY frames are in flight, each frame is read back once the GPU has written all of them,
+// so that the pipeline never stalls. Frames which find no free set of queries are not measured.
+// Per-scope statistics are written as CSV to PROFILE_FILENAME at exit.
+//
+// Scopes may be nested, and must be closed in the frame which opened them:
+//     PROFILE_BEGIN("bloom");
+//     ...
+//     PROFILE_END();
+// Both macros compile to nothing outside of profile builds.
+
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROFILE_BEGIN(name) profilerBegin(name)
+#define PROFILE_END() profilerEnd()
+
+#define PROFILER_MAX_SCOPES 32
+#define PROFILER_MAX_FRAME_ENTRIES 64
+#define PROFILER_MAX_DEPTH 16
+
+// Per scope, percentiles are computed over this many last samples, about a minute at 60 FPS.
+#define PROFILER_MAX_SAMPLES 4096
+
+struct ProfilerScope
+{
+	const char *name;
+	float samples[PROFILER_MAX_SAMPLES];
+	int sampleCount;
+	float min;
+	float max;
+	double sum;
+};
+
+struct ProfilerEntry
+{
+	int scope;
+	GLuint queries[2];
+};
+
+struct ProfilerFrame
+{
+	ProfilerEntry entries[PROFILER_MAX_FRAME_ENTRIES];
+	int entryCount;
+};
+
+static ProfilerScope profilerScopes[PROFILER_MAX_SCOPES];
+static int profilerScopeCount;
+static ProfilerFrame profilerFrames[PROFILE_LATENCY];
+
+// Measured frames, and those which have been read back.
+static int profilerFrameNumber;
+static int profilerCollectedFrameNumber;
+static bool profilerFrameMeasured;
+
+static int profilerStack[PROFILER_MAX_DEPTH];
+static int profilerDepth;
+
+// Scopes opened beyond the maximal depth, whose ends are skipped.
+static int profilerOverflowDepth;
+
+static void profilerInitialize()
+{
+	for (int i = 0; i < PROFILE_LATENCY; ++i)
+	{
+		for (int j = 0; j < PROFILER_MAX_FRAME_ENTRIES; ++j)
+		{
+			glGenQueries(2, profilerFrames[i].entries[j].queries);
+			checkGLError();
+		}
+	}
+}
+
+// Scope names are usually literals, so they are compared by address first.
+static int profilerFindScope(const char *name)
+{
+	for (int i = 0; i < profilerScopeCount; ++i)
+	{
+		if (profilerScopes[i].name == name || !strcmp(profilerScopes[i].name, name))
+		{
+			return i;
+		}
+	}
+
+	if (profilerScopeCount == PROFILER_MAX_SCOPES)
+	{
+		return -1;
+	}
+
+	profilerScopes[profilerScopeCount].name = name;
+	return profilerScopeCount++;
+}
+
+static void profilerBegin(const char *name)
+{
+	ProfilerFrame &frame = profilerFrames[profilerFrameNumber % PROFILE_LATENCY];
+	int scope = profilerFindScope(name);
+
+	if (profilerDepth == PROFILER_MAX_DEPTH)
+	{
+		++profilerOverflowDepth;
+		return;
+	}
+
+	if (!profilerFrameMeasured || scope < 0 || frame.entryCount == PROFILER_MAX_FRAME_ENTRIES)
+	{
+		// Still matched by profilerEnd, but not measured.
+		profilerStack[profilerDepth++] = -1;
+		return;
+	}
+
+	ProfilerEntry &entry = frame.entries[frame.entryCount];
+	entry.scope = scope;
+	glQueryCounter(entry.queries[0], GL_TIMESTAMP);
+	checkGLError();
+
+	profilerStack[profilerDepth++] = frame.entryCount++;
+}
+
+static void profilerEnd()
+{
+	if (profilerOverflowDepth > 0)
+	{
+		--profilerOverflowDepth;
+		return;
+	}
+
+	if (profilerDepth == 0)
+	{
+		return;
+	}
+
+	int entryIndex = profilerStack[--profilerDepth];
+	if (entryIndex >= 0)
+	{
+		ProfilerFrame &frame = profilerFrames[profilerFrameNumber % PROFILE_LATENCY];
+		glQueryCounter(frame.entries[entryIndex].queries[1], GL_TIMESTAMP);
+		checkGLError();
+	}
+}
+
+// Returns false without waiting when the GPU has not written all the queries of the frame yet.
+static bool profilerCollect(ProfilerFrame &frame, bool wait)
+{
+	// Timestamps are written in order, and the end of the frame scope is the last one.
+	if (!wait && frame.entryCount > 0)
+	{
+		GLuint available;
+		glGetQueryObjectuiv(frame.entries[0].queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		checkGLError();
+		if (!available)
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < frame.entryCount; ++i)
+	{
+		ProfilerEntry &entry = frame.entries[i];
+
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(entry.queries[0], GL_QUERY_RESULT, &begin);
+		checkGLError();
+		glGetQueryObjectui64v(entry.queries[1], GL_QUERY_RESULT, &end);
+		checkGLError();
+
+		ProfilerScope &scope = profilerScopes[entry.scope];
+		float sample = (float)(end - begin) / 1000000.0f;
+		if (scope.sampleCount == 0 || sample < scope.min)
+		{
+			scope.min = sample;
+		}
+		if (scope.sampleCount == 0 || sample > scope.max)
+		{
+			scope.max = sample;
+		}
+		scope.sum += sample;
+		scope.samples[scope.sampleCount++ % PROFILER_MAX_SAMPLES] = sample;
+	}
+
+	frame.entryCount = 0;
+	return true;
+}
+
+// Collects the frames which the GPU has finished, in order, then opens the frame scope when a set of queries is free.
+static void profilerBeginFrame()
+{
+	while (profilerCollectedFrameNumber < profilerFrameNumber &&
+		   profilerCollect(profilerFrames[profilerCollectedFrameNumber % PROFILE_LATENCY], false))
+	{
+		++profilerCollectedFrameNumber;
+	}
+
+	profilerFrameMeasured = profilerFrameNumber - profilerCollectedFrameNumber < PROFILE_LATENCY;
+	profilerDepth = 0;
+	profilerOverflowDepth = 0;
+	profilerBegin("frame");
+}
+
+static void profilerEndFrame()
+{
+	while (profilerDepth > 0)
+	{
+		profilerEnd();
+	}
+
+	if (profilerFrameMeasured)
+	{
+		++profilerFrameNumber;
+	}
+}
+
+static int profilerCompareSamples(const void *a, const void *b)
+{
+	float difference = *(const float *)a - *(const float *)b;
+	return difference < 0 ? -1 : difference > 0;
+}
+
+static void profilerWrite()
+{
+	while (profilerCollectedFrameNumber < profilerFrameNumber)
+	{
+		profilerCollect(profilerFrames[profilerCollectedFrameNumber++ % PROFILE_LATENCY], true);
+	}
+
+	FILE *file = fopen(PROFILE_FILENAME, "w");
+	if (!file)
+	{
+		return;
+	}
+
+	fprintf(file, "scope,samples,min (ms),mean (ms),p95 (ms),p99 (ms),max (ms)\n");
+
+	for (int i = 0; i < profilerScopeCount; ++i)
+	{
+		ProfilerScope &scope = profilerScopes[i];
+		int count = scope.sampleCount < PROFILER_MAX_SAMPLES ? scope.sampleCount : PROFILER_MAX_SAMPLES;
+		if (count == 0)
+		{
+			continue;
+		}
+
+		qsort(scope.samples, count, sizeof(float), profilerCompareSamples);
+
+		fprintf(
+			file,
+			"%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			scope.name,
+			scope.sampleCount,
+			scope.min,
+			scope.sum / scope.sampleCount,
+			scope.samples[(count - 1) * 95 / 100],
+			scope.samples[(count - 1) * 99 / 100],
+			scope.max);
+	}
+
+	fclose(file);
+}
+
+#else
+
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+
+#endif
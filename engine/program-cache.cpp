@@ -0,0 +1,220 @@
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+#include <stdio.h>
+
+#include "demo.hpp"
+
+#include "debug.hpp"
+#include "program-cache.hpp"
+
+#define PROGRAM_CACHE_MAX_SHADER_COUNT 8
+#define PROGRAM_CACHE_MAX_PENDING_COUNT 64
+
+// Programs linked from sources, whose logs are displayed and binaries stored by programCacheFinish.
+struct PendingProgram
+{
+	GLint program;
+	unsigned long long key;
+};
+
+static PendingProgram pendingPrograms[PROGRAM_CACHE_MAX_PENDING_COUNT];
+static int pendingProgramCount;
+
+// FNV-1a.
+static unsigned long long programCacheHash(unsigned long long hash, const char *data, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+static unsigned long long programCacheHashString(unsigned long long hash, const char *str)
+{
+	// The terminating character separates consecutive strings.
+	return programCacheHash(hash, str, strlen(str) + 1);
+}
+
+// Shader sources are stored by the driver as the concatenation of the given strings.
+static unsigned long long programCacheGetKey(GLuint *shaders, GLsizei shaderCount)
+{
+	unsigned long long hash = 14695981039346656037ull;
+
+	hash = programCacheHashString(hash, (const char *)glGetString(GL_VENDOR));
+	hash = programCacheHashString(hash, (const char *)glGetString(GL_RENDERER));
+	hash = programCacheHashString(hash, (const char *)glGetString(GL_VERSION));
+
+	for (GLsizei i = 0; i < shaderCount; ++i)
+	{
+		GLint type, length;
+		glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+		glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length);
+		checkGLError();
+
+		char *source = new char[length + 1];
+		glGetShaderSource(shaders[i], length + 1, NULL, source);
+		checkGLError();
+
+		hash = programCacheHash(hash, (const char *)&type, sizeof(type));
+		hash = programCacheHashString(hash, source);
+
+		delete[] source;
+	}
+
+	return hash;
+}
+
+static void programCacheGetFilename(char *filename, size_t size, unsigned long long key)
+{
+	sprintf_s(filename, size, "%s\\%016llx.bin", PROGRAM_CACHE_DIRECTORY, key);
+}
+
+static bool programCacheLoad(GLint program, unsigned long long key)
+{
+	char filename[MAX_PATH];
+	programCacheGetFilename(filename, sizeof(filename), key);
+
+	FILE *file;
+	if (fopen_s(&file, filename, "rb"))
+	{
+		return false;
+	}
+
+	GLenum format;
+	GLint length = 0;
+	char *binary = nullptr;
+
+	if (fread(&format, sizeof(format), 1, file) == 1 && fread(&length, sizeof(length), 1, file) == 1 && length > 0)
+	{
+		binary = new char[length];
+		if (fread(binary, 1, length, file) != (size_t)length)
+		{
+			delete[] binary;
+			binary = nullptr;
+		}
+	}
+
+	fclose(file);
+
+	if (!binary)
+	{
+		return false;
+	}
+
+	glProgramBinary(program, format, binary, length);
+	delete[] binary;
+
+	// Drivers reject binaries after an update, the program is linked again then.
+	GLint linkStatus;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	glGetError();
+
+	return linkStatus == GL_TRUE;
+}
+
+static void programCacheStore(GLint program, unsigned long long key)
+{
+	GLint length;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	checkGLError();
+	if (length <= 0)
+	{
+		return;
+	}
+
+	char *binary = new char[length];
+	GLenum format;
+	glGetProgramBinary(program, length, &length, &format, binary);
+	checkGLError();
+
+	CreateDirectoryA(PROGRAM_CACHE_DIRECTORY, NULL);
+
+	char filename[MAX_PATH];
+	programCacheGetFilename(filename, sizeof(filename), key);
+
+	FILE *file;
+	if (!fopen_s(&file, filename, "wb"))
+	{
+		fwrite(&format, sizeof(format), 1, file);
+		fwrite(&length, sizeof(length), 1, file);
+		fwrite(binary, 1, length, file);
+		fclose(file);
+	}
+
+	delete[] binary;
+}
+
+void programCacheLink(GLint program)
+{
+	GLuint shaders[PROGRAM_CACHE_MAX_SHADER_COUNT];
+	GLsizei shaderCount;
+	glGetAttachedShaders(program, PROGRAM_CACHE_MAX_SHADER_COUNT, &shaderCount, shaders);
+	checkGLError();
+
+	unsigned long long key = programCacheGetKey(shaders, shaderCount);
+
+	if (GLEW_ARB_get_program_binary && programCacheLoad(program, key))
+	{
+		std::cout << "Program " << program << " loaded from cache." << std::endl;
+		return;
+	}
+
+	for (GLsizei i = 0; i < shaderCount; ++i)
+	{
+		glCompileShader(shaders[i]);
+		checkGLError();
+	}
+
+	if (GLEW_ARB_get_program_binary)
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		checkGLError();
+	}
+
+	glLinkProgram(program);
+	checkGLError();
+
+	if (pendingProgramCount < PROGRAM_CACHE_MAX_PENDING_COUNT)
+	{
+		pendingPrograms[pendingProgramCount].program = program;
+		pendingPrograms[pendingProgramCount].key = key;
+		++pendingProgramCount;
+	}
+}
+
+void programCacheFinish(GLint program)
+{
+	for (int i = 0; i < pendingProgramCount; ++i)
+	{
+		if (pendingPrograms[i].program != program)
+		{
+			continue;
+		}
+
+		GLuint shaders[PROGRAM_CACHE_MAX_SHADER_COUNT];
+		GLsizei shaderCount;
+		glGetAttachedShaders(program, PROGRAM_CACHE_MAX_SHADER_COUNT, &shaderCount, shaders);
+		checkGLError();
+
+		for (GLsizei j = 0; j < shaderCount; ++j)
+		{
+			checkShaderCompilation(shaders[j]);
+		}
+
+		GLint linkStatus;
+		glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+		checkGLError();
+
+		if (linkStatus == GL_TRUE && GLEW_ARB_get_program_binary)
+		{
+			programCacheStore(program, pendingPrograms[i].key);
+		}
+
+		pendingPrograms[i] = pendingPrograms[--pendingProgramCount];
+		return;
+	}
+}
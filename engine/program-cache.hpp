@@ -0,0 +1,15 @@
+#pragma once
+
+#ifdef PROGRAM_CACHE
+
+// Links the program from the sources of its attached shaders,
+// or loads its binary when the same sources have already been linked by the same driver.
+// Attached shaders are compiled only when the cache misses.
+// Nothing is queried, so that the driver can compile several programs in parallel.
+void programCacheLink(GLint program);
+
+// Displays the compilation logs of a program given to programCacheLink,
+// and stores its binary once linked from sources.
+void programCacheFinish(GLint program);
+
+#endif
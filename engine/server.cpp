@@ -12,6 +12,7 @@
 #include "server.hpp"
 
 #include "debug.hpp"
+#include "program-cache.hpp"
 
 #define INITIALIZE_HTTP_RESPONSE(resp, status, reason) \
 	do                                                 \
@@ -244,9 +245,14 @@ static void handleRequest(const HTTP_REQUEST *pRequest)
 					checkGLError();
 					glShaderSource(shader, 1, &body->data, lengths);
 					checkGLError();
+#ifdef PROGRAM_CACHE
+					programCacheLink(options.programs[passIndex]);
+					programCacheFinish(options.programs[passIndex]);
+#else
 					glCompileShader(shader);
 					checkShaderCompilation(shader);
 					glLinkProgram(options.programs[passIndex]);
+#endif
 					checkGLError();
 
 					result = SendHttpResponse(pRequest, 200, "OK", nullptr);
@@ -260,9 +266,14 @@ static void handleRequest(const HTTP_REQUEST *pRequest)
 					checkGLError();
 					glShaderSource(shader, 1, &body->data, lengths);
 					checkGLError();
+#ifdef PROGRAM_CACHE
+					programCacheLink(options.programs[passIndex]);
+					programCacheFinish(options.programs[passIndex]);
+#else
 					glCompileShader(shader);
 					checkShaderCompilation(shader);
 					glLinkProgram(options.programs[passIndex]);
+#endif
 					checkGLError();
 
 					result = SendHttpResponse(pRequest, 200, "OK", nullptr);
@@ -0,0 +1,103 @@
+#pragma once
+
+// Float uniforms are shared by all programs through a std140 uniform block, bound to the binding point 0,
+// which is also the default binding of every block after linking.
+// The buffer is persistently mapped and split into regions used in turn,
+// so that writing a frame never waits for the GPU to read a previous one.
+// Only the uniforms which changed since a region was last written are written and flushed again.
+//
+// Call uniformBlockUpdate once uniforms are set, instead of uploading them to each program.
+
+#ifdef UNIFORM_BLOCK
+
+#define UNIFORM_BLOCK_REGION_COUNT 3
+
+// std140 aligns each array element on 16 bytes.
+#define UNIFORM_BLOCK_STRIDE 4
+#define UNIFORM_BLOCK_SIZE (FLOAT_UNIFORM_COUNT * UNIFORM_BLOCK_STRIDE * sizeof(float))
+
+static GLuint uniformBlockBuffer;
+static char *uniformBlockData;
+static GLint uniformBlockRegionSize;
+static int uniformBlockRegion = -1;
+static bool uniformBlockRegionWritten[UNIFORM_BLOCK_REGION_COUNT];
+static float uniformBlockShadows[UNIFORM_BLOCK_REGION_COUNT][FLOAT_UNIFORM_COUNT];
+static GLsync uniformBlockFences[UNIFORM_BLOCK_REGION_COUNT];
+
+static void uniformBlockInitialize()
+{
+	// Regions start on offsets aligned as the driver requires.
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	checkGLError();
+	uniformBlockRegionSize = (UNIFORM_BLOCK_SIZE + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &uniformBlockBuffer);
+	checkGLError();
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBlockBuffer);
+	checkGLError();
+	glBufferStorage(GL_UNIFORM_BUFFER, uniformBlockRegionSize * UNIFORM_BLOCK_REGION_COUNT, 0, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+	checkGLError();
+	uniformBlockData = (char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, uniformBlockRegionSize * UNIFORM_BLOCK_REGION_COUNT, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+	checkGLError();
+}
+
+static void uniformBlockUpdate()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBlockBuffer);
+	checkGLError();
+
+	// Commands issued since the previous update read its region.
+	if (uniformBlockRegion >= 0)
+	{
+		uniformBlockFences[uniformBlockRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		checkGLError();
+	}
+
+	uniformBlockRegion = (uniformBlockRegion + 1) % UNIFORM_BLOCK_REGION_COUNT;
+
+	GLsync fence = uniformBlockFences[uniformBlockRegion];
+	if (fence)
+	{
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		checkGLError();
+		glDeleteSync(fence);
+		checkGLError();
+		uniformBlockFences[uniformBlockRegion] = 0;
+	}
+
+	int offset = uniformBlockRegion * uniformBlockRegionSize;
+	float *data = (float *)(uniformBlockData + offset);
+	float *shadow = uniformBlockShadows[uniformBlockRegion];
+	bool written = uniformBlockRegionWritten[uniformBlockRegion];
+
+	int first = FLOAT_UNIFORM_COUNT;
+	int last = -1;
+	for (int i = 0; i < FLOAT_UNIFORM_COUNT; ++i)
+	{
+		if (!written || shadow[i] != floatUniforms[i])
+		{
+			shadow[i] = floatUniforms[i];
+			data[i * UNIFORM_BLOCK_STRIDE] = floatUniforms[i];
+
+			if (first > i)
+			{
+				first = i;
+			}
+			last = i;
+		}
+	}
+
+	uniformBlockRegionWritten[uniformBlockRegion] = true;
+
+	if (last >= first)
+	{
+		glFlushMappedBufferRange(GL_UNIFORM_BUFFER, offset + first * UNIFORM_BLOCK_STRIDE * sizeof(float), ((last - first) * UNIFORM_BLOCK_STRIDE + 1) * sizeof(float));
+		checkGLError();
+	}
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, 0, uniformBlockBuffer, offset, UNIFORM_BLOCK_SIZE);
+	checkGLError();
+}
+
+#endif
@@ -1,8 +1,26 @@
 #pragma hook declarations
 
-#define SOUND_TEXTURE_SIZE 2048
+// The song is rendered by the first pass into a texture, in chunks of rows rendered just ahead of the playback.
+// Chunks are read back asynchronously into the sound buffer, which is played from the first one on.
+// Captures render the whole song before the first frame instead, so that frames do not depend on where the capture starts.
+// Each texel holds two stereo samples.
+#define SOUND_TEXTURE_WIDTH 2048
 #define SAMPLE_RATE 44100
-#define MAX_SAMPLES (SOUND_TEXTURE_SIZE * SOUND_TEXTURE_SIZE * 2)
+#define SAMPLES_PER_ROW (SOUND_TEXTURE_WIDTH * 2)
+
+// The texture covers demo:duration when set, about 190 seconds otherwise.
+#ifdef DURATION
+#define SOUND_TEXTURE_HEIGHT (((int)(DURATION * SAMPLE_RATE) + SAMPLES_PER_ROW - 1) / SAMPLES_PER_ROW)
+#else
+#define SOUND_TEXTURE_HEIGHT 2048
+#endif
+#define MAX_SAMPLES (SOUND_TEXTURE_HEIGHT * SAMPLES_PER_ROW)
+
+// A chunk of 16 rows holds about 1.5 second.
+#define SOUND_CHUNK_ROWS 16
+#define SOUND_LOOKAHEAD_ROWS (SOUND_CHUNK_ROWS * 4)
+#define SOUND_PBO_COUNT 4
+
 #define SAMPLE_TYPE float
 #define FLOAT_32BIT
 
@@ -44,10 +62,25 @@ static MMTIME mmTime = {
 	0,
 };
 
+#define AUDIO_WAVE_FORMAT waveFormat
+#define AUDIO_WAVE_HEADER waveHDR
+
+#ifdef CAPTURE
+#define AUDIO_RENDERED_AT_INITIALIZE
+#endif
+
 static GLuint audioTextureId;
 
 static unsigned int fbo;
 
+static GLuint soundPbos[SOUND_PBO_COUNT];
+static GLsync soundFences[SOUND_PBO_COUNT];
+
+// Rows rendered by the GPU, and rows read back into the sound buffer.
+static int soundRenderedRows;
+static int soundReadRows;
+static bool soundPlaying;
+
 #pragma hook initialize
 
 glGenTextures(1, &audioTextureId);
@@ -56,39 +89,55 @@ checkGLError();
 glGenFramebuffers(1, &fbo);
 checkGLError();
 
-glViewport(0, 0, SOUND_TEXTURE_SIZE, SOUND_TEXTURE_SIZE);
-checkGLError();
-
 glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 checkGLError();
 
-glUseProgram(programs[0]);
-checkGLError();
-
 glBindTexture(GL_TEXTURE_2D, audioTextureId);
 checkGLError();
 
-glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SOUND_TEXTURE_SIZE, SOUND_TEXTURE_SIZE, 0, GL_RGBA, GL_FLOAT, NULL);
+glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SOUND_TEXTURE_WIDTH, SOUND_TEXTURE_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
 checkGLError();
 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 checkGLError();
 glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, audioTextureId, 0);
 checkGLError();
 
+glUseProgram(programs[0]);
+checkGLError();
+
+#ifdef CAPTURE
+glViewport(0, 0, SOUND_TEXTURE_WIDTH, SOUND_TEXTURE_HEIGHT);
+checkGLError();
 glRects(-1, -1, 1, 1);
 checkGLError();
+glReadPixels(0, 0, SOUND_TEXTURE_WIDTH, SOUND_TEXTURE_HEIGHT, GL_RGBA, GL_FLOAT, soundBuffer);
+checkGLError();
 
-glReadPixels(0, 0, SOUND_TEXTURE_SIZE, SOUND_TEXTURE_SIZE, GL_RGBA, GL_FLOAT, soundBuffer);
+soundRenderedRows = SOUND_TEXTURE_HEIGHT;
+soundReadRows = SOUND_TEXTURE_HEIGHT;
+#else
+// The second pass samples the first row filtered with the last one, which is rendered from the start.
+glViewport(0, SOUND_TEXTURE_HEIGHT - 1, SOUND_TEXTURE_WIDTH, 1);
 checkGLError();
+glRects(-1, -1, 1, 1);
+checkGLError();
+#endif
 
 glViewport(0, 0, resolutionWidth, resolutionHeight);
 checkGLError();
 
-glFinish();
+glBindFramebuffer(GL_FRAMEBUFFER, 0);
 checkGLError();
 
-glBindFramebuffer(GL_FRAMEBUFFER, 0);
+glGenBuffers(SOUND_PBO_COUNT, soundPbos);
 checkGLError();
+for (int i = 0; i < SOUND_PBO_COUNT; ++i)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, soundPbos[i]);
+	checkGLError();
+	glBufferData(GL_PIXEL_PACK_BUFFER, SOUND_CHUNK_ROWS * SOUND_TEXTURE_WIDTH * 4 * sizeof(float), NULL, GL_STREAM_READ);
+	checkGLError();
+}
 
 glUseProgram(programs[1]);
 checkGLError();
@@ -102,26 +151,111 @@ checkGLError();
 glUniform1i(3, 0);
 checkGLError();
 
-waveOutOpen(&waveOut, WAVE_MAPPER, &waveFormat, NULL, 0, CALLBACK_NULL);
-waveOutPrepareHeader(waveOut, &waveHDR, sizeof(waveHDR));
-waveOutWrite(waveOut, &waveHDR, sizeof(waveHDR));
+#pragma hook audio_time
+
+// Stays at 0 until the first chunk is played.
+if (soundPlaying)
+{
+	waveOutGetPosition(waveOut, &mmTime, sizeof(MMTIME));
+}
+float time = (float)mmTime.u.sample / (float)SAMPLE_RATE;
 
 #pragma hook render
 
-waveOutGetPosition(waveOut, &mmTime, sizeof(MMTIME));
-float time = (float)mmTime.u.sample / (float)SAMPLE_RATE;
+// Chunks are read back in order, once the GPU has rendered them.
+while (soundReadRows < soundRenderedRows)
+{
+	int slot = soundReadRows / SOUND_CHUNK_ROWS % SOUND_PBO_COUNT;
+	GLenum status = glClientWaitSync(soundFences[slot], 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+	{
+		break;
+	}
+
+	glDeleteSync(soundFences[slot]);
+	checkGLError();
+
+	int rows = soundRenderedRows - soundReadRows;
+	if (rows > SOUND_CHUNK_ROWS)
+	{
+		rows = SOUND_CHUNK_ROWS;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, soundPbos[slot]);
+	checkGLError();
+	glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, rows * SOUND_TEXTURE_WIDTH * 4 * sizeof(float), soundBuffer + soundReadRows * SAMPLES_PER_ROW * 2);
+	checkGLError();
+
+	soundReadRows += rows;
+}
+
+// Captures do not play the sound, their time does not come from the playback.
+#ifndef CAPTURE
+if (!soundPlaying && soundReadRows > 0)
+{
+	waveOutOpen(&waveOut, WAVE_MAPPER, &waveFormat, NULL, 0, CALLBACK_NULL);
+	waveOutPrepareHeader(waveOut, &waveHDR, sizeof(waveHDR));
+	waveOutWrite(waveOut, &waveHDR, sizeof(waveHDR));
+	soundPlaying = true;
+}
+#endif
+
+// At most one chunk per frame, when a buffer is free and the demo time is close enough.
+// The time is compared as a float, which avoids the float to integer conversion of the C runtime.
+if (soundRenderedRows < SOUND_TEXTURE_HEIGHT &&
+	soundRenderedRows - soundReadRows < SOUND_CHUNK_ROWS * SOUND_PBO_COUNT &&
+	(float)soundRenderedRows < time * ((float)SAMPLE_RATE / SAMPLES_PER_ROW) + SOUND_LOOKAHEAD_ROWS)
+{
+	int slot = soundRenderedRows / SOUND_CHUNK_ROWS % SOUND_PBO_COUNT;
+	int rows = SOUND_TEXTURE_HEIGHT - soundRenderedRows;
+	if (rows > SOUND_CHUNK_ROWS)
+	{
+		rows = SOUND_CHUNK_ROWS;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	checkGLError();
+	glViewport(0, soundRenderedRows, SOUND_TEXTURE_WIDTH, rows);
+	checkGLError();
+	glUseProgram(programs[0]);
+	checkGLError();
+	glRects(-1, -1, 1, 1);
+	checkGLError();
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, soundPbos[slot]);
+	checkGLError();
+	glReadPixels(0, soundRenderedRows, SOUND_TEXTURE_WIDTH, rows, GL_RGBA, GL_FLOAT, 0);
+	checkGLError();
+	soundFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	checkGLError();
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	checkGLError();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	checkGLError();
+	glViewport(0, 0, resolutionWidth, resolutionHeight);
+	checkGLError();
+	glUseProgram(programs[1]);
+	checkGLError();
+
+	soundRenderedRows += rows;
+}
 
 uniformTime = time;
 
+#ifdef UNIFORM_BLOCK
+uniformBlockUpdate();
+#else
 glUniform1fv(0, FLOAT_UNIFORM_COUNT, floatUniforms);
 checkGLError();
+#endif
 
 glRects(-1, -1, 1, 1);
 checkGLError();
 
 #pragma hook audio_duration
 
-return MAX_SAMPLES / (float)SAMPLE_RATE;
+MAX_SAMPLES / (float)SAMPLE_RATE
 
 #pragma hook audio_is_playing
 
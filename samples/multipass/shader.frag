@@ -12,11 +12,6 @@ const float PI = 3.14;//! replace
 vec4 _gl_Position;
 #define gl_Position _gl_Position
 
-#pragma attributes
-
-vec3 aPosition;
-vec2 aUV;
-
 #pragma varyings
 
 vec3 vColor;
@@ -40,17 +35,17 @@ vec3 curve(float ratio) {
 
 #pragma vertex 0
 
+// Each instance is a strip of 100 quads, vertices alternate between its two edges.
 void mainV0() {
-	vec3 position = aPosition;
-	float ratio = aUV.x * 0.5 + position.x * 2.0;
-	float i = position.x;
-	position = curve(ratio);
+	vec2 uv = vec2(float(gl_VertexID / 2) / 100.0, float(gl_VertexID % 2)) * 2.0 - 1.0;
+	float ratio = uv.x * 0.5 + float(gl_InstanceID) * 2.0;
+	vec3 position = curve(ratio);
 	vec3 next = curve(ratio + 0.01);
 	vec2 y = normalize(next.xy - position.xy);
 	vec2 x = vec2(y.y, - y.x);
-	position.xy += x * aUV.y * (0.01 + 0.01 * position.z);
+	position.xy += x * uv.y * (0.01 + 0.01 * position.z);
 	gl_Position = vec4(position.xy, 0.0, 1.0);
-	vColor = vec3(aUV.xy * 0.5 + 0.5, 0);
+	vColor = vec3(uv * 0.5 + 0.5, 0);
 }
 
 #pragma fragment 0
@@ -12,7 +12,9 @@ export class VierKlangAudioSynthesizer implements IAudioSynthesizer {
 	}
 
 	getDefaultConfig() {
-		return {};
+		return {
+			loadingProgress: false,
+		};
 	}
 
 	checkConfig() {
@@ -24,5 +26,12 @@ export class VierKlangAudioSynthesizer implements IAudioSynthesizer {
 			compilation.cpp.hooks,
 			join('engine', 'audio-synthesizer-hooks', '4klang.cpp')
 		);
+
+		if (this.config.get('demo:audio-synthesizer:loadingProgress')) {
+			await addHooks(
+				compilation.cpp.hooks,
+				join('engine', 'audio-synthesizer-hooks', '4klang-loading-progress.cpp')
+			);
+		}
 	}
 }
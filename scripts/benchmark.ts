@@ -0,0 +1,193 @@
+import { spawn as originalSpawn } from 'child_process';
+import { writeFile } from 'fs-extra';
+import { join, resolve } from 'path';
+import { createInterface } from 'readline';
+
+import { IContext } from './definitions';
+
+export interface IBenchmarkResolution {
+	height: number;
+	width: number;
+}
+
+export interface IBenchmarkResult {
+	// In milliseconds, indexed by frame.
+	frameTimes: number[];
+	resolution: IBenchmarkResolution;
+}
+
+interface IBenchmarkStatistics {
+	count: number;
+	max: number;
+	mean: number;
+	min: number;
+	p95: number;
+	p99: number;
+}
+
+function getStatistics(frameTimes: number[]): IBenchmarkStatistics {
+	const sorted = frameTimes.slice().sort((a, b) => a - b);
+	const count = sorted.length;
+
+	return {
+		count,
+		max: sorted[count - 1],
+		mean: sorted.reduce((sum, frameTime) => sum + frameTime, 0) / count,
+		min: sorted[0],
+		p95: sorted[Math.floor((count - 1) * 0.95)],
+		p99: sorted[Math.floor((count - 1) * 0.99)],
+	};
+}
+
+export function runBenchmark(
+	context: IContext,
+	resolution: IBenchmarkResolution
+) {
+	const exePath = resolve(context.config.get('paths:exe'));
+
+	return new Promise<IBenchmarkResult>((resolvePromise, reject) => {
+		console.log(
+			`Executing ${exePath} at ${resolution.width}x${resolution.height}`
+		);
+
+		const result: IBenchmarkResult = {
+			frameTimes: [],
+			resolution,
+		};
+		let frequency = 0;
+
+		const demo = originalSpawn(exePath, [], {
+			stdio: ['ignore', 'inherit', 'pipe'],
+		});
+
+		createInterface({ input: demo.stderr }).on('line', (line: string) => {
+			const match = /^benchmark (\w+) (\d+)(?: (\d+))?$/.exec(line);
+			if (!match) {
+				console.error(line);
+				return;
+			}
+
+			const value = parseInt(match[2], 10);
+			switch (match[1]) {
+				case 'frequency':
+					frequency = value;
+					break;
+
+				case 'frames':
+					result.frameTimes = new Array(value).fill(-1);
+					break;
+
+				case 'frame':
+					result.frameTimes[value] =
+						(parseInt(match[3], 10) * 1000) / frequency;
+					break;
+			}
+		});
+
+		demo.on('close', (code, signal) => {
+			if (code) {
+				reject(new Error(exePath + ' exited with code ' + code + '.'));
+			} else if (signal) {
+				reject(new Error(exePath + ' was stopped by signal ' + signal + '.'));
+			} else if (result.frameTimes.some((frameTime) => frameTime < 0)) {
+				reject(new Error(exePath + ' did not report every frame.'));
+			} else {
+				resolvePromise(result);
+			}
+		});
+	});
+}
+
+// One row per resolution for the whole run, then one per time window.
+export async function writeBenchmarkReport(
+	context: IContext,
+	results: IBenchmarkResult[]
+) {
+	const { config } = context;
+
+	const fps: number = config.get('benchmark:fps');
+	const start: number = config.get('benchmark:start');
+	const framesPerWindow = Math.max(
+		1,
+		Math.round(config.get('benchmark:window') * fps)
+	);
+
+	const lines = [
+		'resolution,start (s),end (s),frames,min (ms),mean (ms),p95 (ms),p99 (ms),max (ms)',
+	];
+
+	function addLine(
+		resolution: string,
+		firstFrame: number,
+		endFrame: number,
+		statistics: IBenchmarkStatistics
+	) {
+		lines.push(
+			[
+				resolution,
+				(start + firstFrame / fps).toFixed(2),
+				(start + endFrame / fps).toFixed(2),
+				statistics.count,
+				statistics.min.toFixed(3),
+				statistics.mean.toFixed(3),
+				statistics.p95.toFixed(3),
+				statistics.p99.toFixed(3),
+				statistics.max.toFixed(3),
+			].join(',')
+		);
+	}
+
+	results.forEach((result) => {
+		const { frameTimes } = result;
+		if (frameTimes.length === 0) {
+			return;
+		}
+
+		const resolution = `${result.resolution.width}x${result.resolution.height}`;
+
+		const total = getStatistics(frameTimes);
+		addLine(resolution, 0, frameTimes.length, total);
+
+		let worstFirstFrame = 0;
+		let worst: IBenchmarkStatistics | null = null;
+
+		for (
+			let firstFrame = 0;
+			firstFrame < frameTimes.length;
+			firstFrame += framesPerWindow
+		) {
+			const endFrame = Math.min(
+				firstFrame + framesPerWindow,
+				frameTimes.length
+			);
+			const statistics = getStatistics(
+				frameTimes.slice(firstFrame, endFrame)
+			);
+			addLine(resolution, firstFrame, endFrame, statistics);
+
+			if (!worst || statistics.mean > worst.mean) {
+				worstFirstFrame = firstFrame;
+				worst = statistics;
+			}
+		}
+
+		console.log(
+			`${resolution}: mean ${total.mean.toFixed(
+				3
+			)} ms, p99 ${total.p99.toFixed(3)} ms.`
+		);
+
+		if (worst) {
+			console.log(
+				`${resolution}: slowest window from ${(
+					start +
+					worstFirstFrame / fps
+				).toFixed(2)} s, mean ${worst.mean.toFixed(3)} ms.`
+			);
+		}
+	});
+
+	const filename = join(config.get('paths:build'), 'benchmark.csv');
+	await writeFile(filename, lines.join('\n') + '\n');
+	console.log(`Benchmark written to ${filename}.`);
+}
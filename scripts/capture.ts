@@ -1,54 +1,117 @@
-import { emptyDir } from 'fs-extra';
+import { spawn as originalSpawn } from 'child_process';
+import {
+	close,
+	emptyDir,
+	open,
+	pathExists,
+	read,
+	readFile,
+	stat,
+} from 'fs-extra';
 import { join, resolve } from 'path';
+import { createInterface } from 'readline';
 
 import { IContext } from './definitions';
 import { spawn } from './lib';
 
-export async function spawnCapture(context: IContext) {
-	const { config } = context;
-	const framesDirectory = config.get('paths:frames');
-
-	await emptyDir(framesDirectory);
-
-	await spawn(resolve(config.get('paths:exe')), [], {
-		cwd: framesDirectory,
-	});
-}
-
-export async function encode(context: IContext) {
+function getFramesInputArgs(context: IContext) {
 	const { config } = context;
 	const framesDirectory = config.get('paths:frames');
 
 	const args = [
-		'-y',
-		'-f',
-		'image2',
 		'-r',
 		config.get('capture:fps'),
 		'-s',
 		config.get('capture:width') + 'x' + config.get('capture:height'),
 		'-pix_fmt',
-		'rgb24',
-		'-start_number',
-		'0',
-		'-i',
-		join(framesDirectory, '%05d.raw'),
+		config.get('capture:pixelFormat'),
 	];
 
-	if (config.get('capture:audioFilename')) {
-		args.push(
-			'-i',
-			join(config.get('directory'), config.get('capture:audioFilename'))
-		);
-	} else {
+	switch (config.get('capture:output')) {
+		case 'frames':
+			args.unshift('-f', 'image2');
+			args.push(
+				'-start_number',
+				'0',
+				'-i',
+				join(framesDirectory, '%05d.raw')
+			);
+			break;
+
+		case 'pipe':
+			args.unshift('-f', 'rawvideo');
+			args.push('-i', '-');
+			break;
+
+		case 'stream':
+			args.unshift('-f', 'rawvideo');
+			args.push('-i', join(framesDirectory, 'frames.raw'));
+			break;
+	}
+
+	return args;
+}
+
+function getRenderedAudioFilename(context: IContext) {
+	return join(context.config.get('paths:frames'), 'audio.wav');
+}
+
+// The demo patches the RIFF size once all the samples are written.
+async function isRenderedAudioComplete(context: IContext) {
+	const filename = getRenderedAudioFilename(context);
+	if (!(await pathExists(filename))) {
+		return false;
+	}
+
+	const header = Buffer.alloc(8);
+	const fd = await open(filename, 'r');
+	try {
+		const { bytesRead } = await read(fd, header, 0, header.length, 0);
+		const riffSize = bytesRead === header.length ? header.readUInt32LE(4) : 0;
+		return riffSize !== 0 && riffSize + 8 === (await stat(filename)).size;
+	} finally {
+		await close(fd);
+	}
+}
+
+// Synthesizers which render offline write the music next to the frames.
+async function getAudioFilename(context: IContext) {
+	const { config } = context;
+
+	const renderedFilename = getRenderedAudioFilename(context);
+	if (await isRenderedAudioComplete(context)) {
+		return renderedFilename;
+	}
+
+	if (await pathExists(renderedFilename)) {
 		console.warn(
-			'capture:audioFilename has not been set, video will be silent.'
+			`${renderedFilename} is incomplete, resume the capture to render it again.`
 		);
 	}
 
+	if (config.get('capture:audioFilename')) {
+		return join(config.get('directory'), config.get('capture:audioFilename'));
+	}
+
+	console.warn('capture:audioFilename has not been set, video will be silent.');
+	return null;
+}
+
+function getEncodeArgs(context: IContext, audioFilename: string | null) {
+	const { config } = context;
+
+	const args = ['-y'].concat(getFramesInputArgs(context));
+
+	if (audioFilename) {
+		args.push('-i', audioFilename);
+	}
+
+	// Frames converted on the GPU are already flipped.
+	if (config.get('capture:pixelFormat') === 'rgb24') {
+		args.push('-vf', 'vflip');
+	}
+
 	args.push(
-		'-vf',
-		'vflip',
 		'-codec:v',
 		'libx264',
 		'-crf',
@@ -70,5 +133,455 @@ export async function encode(context: IContext) {
 		join(config.get('paths:dist'), config.get('demo:name') + '.mp4')
 	);
 
-	await spawn(config.get('tools:ffmpeg'), args);
+	return args;
+}
+
+// Frames go straight from the demo's standard output to ffmpeg's standard input.
+async function spawnPipedCapture(context: IContext) {
+	const { config } = context;
+
+	const exePath = resolve(config.get('paths:exe'));
+	const ffmpegPath = config.get('tools:ffmpeg');
+	const ffmpegArgs = getEncodeArgs(context, await getAudioFilename(context));
+
+	return new Promise<void>((resolvePromise, reject) => {
+		console.log(
+			`Executing ${exePath} | ${ffmpegPath} ${ffmpegArgs.join(' ')}`
+		);
+
+		const demo = originalSpawn(exePath, [], {
+			cwd: config.get('paths:frames'),
+			stdio: ['ignore', 'pipe', 'inherit'],
+		});
+
+		const ffmpeg = originalSpawn(ffmpegPath, ffmpegArgs, {
+			stdio: ['pipe', 'inherit', 'inherit'],
+		});
+
+		demo.stdout.pipe(ffmpeg.stdin);
+
+		let runningCount = 2;
+
+		function onClose(command: string) {
+			return (code: number, signal: string) => {
+				if (code) {
+					reject(new Error(command + ' exited with code ' + code + '.'));
+				} else if (signal) {
+					reject(
+						new Error(command + ' was stopped by signal ' + signal + '.')
+					);
+				} else if (--runningCount === 0) {
+					resolvePromise();
+				}
+			};
+		}
+
+		demo.on('close', onClose(exePath));
+		ffmpeg.on('close', onClose(ffmpegPath));
+	});
+}
+
+function getFrameSize(context: IContext) {
+	const { config } = context;
+	const pixelCount = config.get('capture:width') * config.get('capture:height');
+
+	return config.get('capture:pixelFormat') === 'yuv420p'
+		? (pixelCount * 3) / 2
+		: pixelCount * 3;
+}
+
+// At least 5 digits, as the demo writes them and as ffmpeg reads them with %05d.
+function getFrameFilename(context: IContext, frame: number) {
+	const name = frame.toString().padStart(5, '0') + '.raw';
+	return join(context.config.get('paths:frames'), name);
+}
+
+// Same as the demo's, on 32-bit words then on the remaining bytes, checked against the manifest.
+function getChecksum(data: Buffer) {
+	const wordsEnd = data.length - (data.length % 4);
+	let hash = 2166136261;
+	for (let i = 0; i < wordsEnd; i += 4) {
+		hash = Math.imul(hash ^ data.readUInt32LE(i), 16777619);
+	}
+	for (let i = wordsEnd; i < data.length; ++i) {
+		hash = Math.imul(hash ^ data[i], 16777619);
+	}
+
+	return hash >>> 0;
+}
+
+// Frames which exist with the right size, without reading them.
+async function hasFrame(context: IContext, frame: number, size: number) {
+	const { config } = context;
+
+	const filename =
+		config.get('capture:output') === 'stream'
+			? join(config.get('paths:frames'), 'frames.raw')
+			: getFrameFilename(context, frame);
+	if (!(await pathExists(filename))) {
+		return false;
+	}
+
+	const fileSize = (await stat(filename)).size;
+	return config.get('capture:output') === 'stream'
+		? fileSize >= (frame + 1) * size
+		: fileSize === size;
+}
+
+async function readFrame(context: IContext, frame: number, size: number) {
+	const { config } = context;
+
+	if (config.get('capture:output') === 'stream') {
+		const data = Buffer.alloc(size);
+		const fd = await open(join(config.get('paths:frames'), 'frames.raw'), 'r');
+		try {
+			const { bytesRead } = await read(fd, data, 0, size, frame * size);
+			return bytesRead === size ? data : null;
+		} finally {
+			await close(fd);
+		}
+	}
+
+	const filename = getFrameFilename(context, frame);
+	return (await pathExists(filename)) ? readFile(filename) : null;
+}
+
+interface ICaptureManifest {
+	frameCount: number;
+	validFrames: Set<number>;
+}
+
+// Frames recorded last may have been cut while being written, they are hashed.
+// The demo only hashes as many frames at the end of each segment,
+// the last frames of an interrupted segment are rendered again.
+const hashedFrameCount = 16;
+
+// Same loop as the demo, which compares float times with the duration.
+function getCaptureFrameCount(fps: number, duration: number) {
+	let frameCount = 0;
+	while (Math.fround(frameCount / fps) < duration) {
+		++frameCount;
+	}
+
+	return frameCount;
+}
+
+// The demo appends a line to the manifest for each frame written.
+// A frame is valid if its latest line matches the frame size, and its file has this size.
+// Hashing every frame would take longer than rendering it again,
+// so only the frames recorded last, a few per segment, are also checked against their data.
+// Those recorded without a checksum are not trusted.
+// The manifest is rejected when it was written with other settings.
+async function readCaptureManifest(
+	context: IContext
+): Promise<ICaptureManifest | null> {
+	const manifestPath = join(
+		context.config.get('paths:frames'),
+		'frames.manifest'
+	);
+	if (!(await pathExists(manifestPath))) {
+		return null;
+	}
+
+	const { config } = context;
+	const frameSize = getFrameSize(context);
+	const checksums = new Map<number, number | undefined>();
+	let frameCount = 0;
+	let settings = '';
+
+	for (const line of (await readFile(manifestPath, 'utf8')).split('\n')) {
+		const fields = line.split(' ');
+		const value = parseInt(fields[1], 10);
+		switch (fields[0]) {
+			case 'frames':
+				frameCount = value;
+				settings = fields.slice(2).join(' ');
+				break;
+
+			case 'frame':
+				// Map keeps the order of the latest insertion, which is the order frames were recorded.
+				checksums.delete(value);
+				if (parseInt(fields[2], 10) === frameSize) {
+					checksums.set(
+						value,
+						fields[3] ? parseInt(fields[3], 16) : undefined
+					);
+				}
+				break;
+		}
+	}
+
+	const expectedSettings = [
+		config.get('capture:fps'),
+		config.get('capture:width'),
+		config.get('capture:height'),
+	].join(' ');
+	if (settings !== expectedSettings) {
+		console.warn(
+			`Capture manifest was written with fps, width and height ${settings} instead of ${expectedSettings}, capturing again.`
+		);
+		return null;
+	}
+
+	// Without demo:duration, the frame count comes from the music, which only the demo knows.
+	const duration = config.get('demo:duration');
+	if (duration) {
+		const expectedFrameCount = getCaptureFrameCount(
+			config.get('capture:fps'),
+			duration
+		);
+		if (frameCount !== expectedFrameCount) {
+			console.warn(
+				`Capture manifest has ${frameCount} frames instead of ${expectedFrameCount}, capturing again.`
+			);
+			return null;
+		}
+	}
+
+	const segmentCount: number = config.get('capture:segments');
+	const recordedFrames = Array.from(checksums.keys());
+	const hashedFrames = new Set(
+		recordedFrames.slice(-hashedFrameCount * segmentCount)
+	);
+
+	const validFrames = new Set<number>();
+	for (const [frame, checksum] of checksums) {
+		if (hashedFrames.has(frame)) {
+			if (checksum === undefined) {
+				continue;
+			}
+
+			const data = await readFrame(context, frame, frameSize);
+			if (data && data.length === frameSize && getChecksum(data) === checksum) {
+				validFrames.add(frame);
+			}
+		} else if (await hasFrame(context, frame, frameSize)) {
+			validFrames.add(frame);
+		}
+	}
+
+	console.log(
+		`Capture manifest: ${validFrames.size} valid frames out of ${frameCount}.`
+	);
+
+	return { frameCount, validFrames };
+}
+
+interface ICaptureSegment {
+	currentFrame: number;
+	endFrame: number;
+	firstFrame: number | null;
+	startFrame: number;
+	writtenFrameCount: number;
+}
+
+// The demo reports its frame range, its progress and its written frame count on the standard error.
+function spawnCaptureSegment(
+	context: IContext,
+	segment: ICaptureSegment,
+	index: number,
+	count: number
+) {
+	const { config } = context;
+
+	const exePath = resolve(config.get('paths:exe'));
+	const args = [index.toString(), count.toString()];
+	if (segment.firstFrame !== null) {
+		args.push(segment.firstFrame.toString());
+	}
+
+	return new Promise<void>((resolvePromise, reject) => {
+		console.log(`Executing ${exePath} ${args.join(' ')}`);
+
+		const demo = originalSpawn(exePath, args, {
+			cwd: config.get('paths:frames'),
+			stdio: ['ignore', 'inherit', 'pipe'],
+		});
+
+		createInterface({ input: demo.stderr }).on('line', (line: string) => {
+			const match = /^capture (\w+) (\d+)(?: (\d+))?$/.exec(line);
+			if (!match) {
+				console.error(line);
+				return;
+			}
+
+			const value = parseInt(match[2], 10);
+			switch (match[1]) {
+				case 'range':
+					segment.startFrame = value;
+					segment.endFrame = parseInt(match[3], 10);
+					if (segment.firstFrame === null) {
+						segment.firstFrame = value;
+					}
+					segment.currentFrame = segment.firstFrame;
+					break;
+
+				case 'progress':
+					segment.currentFrame = value;
+					break;
+
+				case 'done':
+					segment.currentFrame = segment.endFrame;
+					segment.writtenFrameCount = value;
+					break;
+			}
+		});
+
+		demo.on('close', (code, signal) => {
+			if (code) {
+				reject(new Error(exePath + ' exited with code ' + code + '.'));
+			} else if (signal) {
+				reject(new Error(exePath + ' was stopped by signal ' + signal + '.'));
+			} else {
+				resolvePromise();
+			}
+		});
+	});
+}
+
+// Each segment renders its own frame range in its own process.
+// Frames are named or placed by their number, so segments are stitched in order by construction.
+// When resuming, each segment restarts at its first missing or corrupt frame.
+async function spawnSegmentedCapture(
+	context: IContext,
+	manifest: ICaptureManifest | null
+) {
+	const { config } = context;
+	const segmentCount: number = config.get('capture:segments');
+
+	const segments: ICaptureSegment[] = [];
+	for (let i = 0; i < segmentCount; ++i) {
+		const segment: ICaptureSegment = {
+			currentFrame: 0,
+			endFrame: 0,
+			firstFrame: null,
+			startFrame: 0,
+			writtenFrameCount: -1,
+		};
+
+		if (manifest) {
+			// Same range as computed by the demo.
+			segment.startFrame = Math.floor((manifest.frameCount * i) / segmentCount);
+			segment.endFrame = Math.floor(
+				(manifest.frameCount * (i + 1)) / segmentCount
+			);
+
+			let firstFrame = segment.startFrame;
+			while (
+				firstFrame < segment.endFrame &&
+				manifest.validFrames.has(firstFrame)
+			) {
+				++firstFrame;
+			}
+
+			segment.firstFrame = firstFrame;
+			segment.currentFrame = firstFrame;
+			if (firstFrame === segment.endFrame) {
+				segment.writtenFrameCount = 0;
+			}
+		}
+
+		segments.push(segment);
+	}
+
+	// Every segment which runs renders the music when it is incomplete.
+	// When all frames are there, the last frame of the first segment is captured again for it.
+	if (
+		manifest &&
+		segments.every((segment) => segment.firstFrame === segment.endFrame) &&
+		!(await isRenderedAudioComplete(context))
+	) {
+		const segment = segments[0];
+		if (segment.endFrame > segment.startFrame) {
+			segment.firstFrame = segment.endFrame - 1;
+			segment.currentFrame = segment.firstFrame;
+			segment.writtenFrameCount = -1;
+		}
+	}
+
+	function reportProgress() {
+		console.log(
+			'Capture progress: ' +
+				segments
+					.map((segment, index) => {
+						const doneCount = segment.currentFrame - segment.startFrame;
+						const frameCount = segment.endFrame - segment.startFrame;
+						const percent = frameCount ? (doneCount * 100) / frameCount : 0;
+						return `segment ${index} ${Math.floor(percent)}%`;
+					})
+					.join(', ')
+		);
+	}
+
+	const progressInterval = setInterval(reportProgress, 5000);
+
+	try {
+		await Promise.all(
+			segments.map((segment, index) =>
+				segment.firstFrame === segment.endFrame && manifest
+					? Promise.resolve()
+					: spawnCaptureSegment(context, segment, index, segmentCount)
+			)
+		);
+	} finally {
+		clearInterval(progressInterval);
+	}
+
+	reportProgress();
+
+	let frameCount = 0;
+	segments.forEach((segment, index) => {
+		if (segment.startFrame !== frameCount) {
+			throw new Error(
+				`Capture segment ${index} starts at frame ${segment.startFrame} instead of ${frameCount}.`
+			);
+		}
+
+		const segmentFrameCount = segment.endFrame - (segment.firstFrame as number);
+		if (segment.writtenFrameCount !== segmentFrameCount) {
+			throw new Error(
+				`Capture segment ${index} wrote ${segment.writtenFrameCount} frames out of ${segmentFrameCount}.`
+			);
+		}
+
+		frameCount = segment.endFrame;
+	});
+
+	console.log(`Captured ${frameCount} frames in ${segmentCount} segments.`);
+}
+
+export async function spawnCapture(context: IContext) {
+	const { config } = context;
+
+	if (config.get('capture:output') === 'pipe') {
+		await emptyDir(config.get('paths:frames'));
+		await spawnPipedCapture(context);
+		return;
+	}
+
+	let manifest: ICaptureManifest | null = null;
+	if (config.get('resume')) {
+		manifest = await readCaptureManifest(context);
+	}
+
+	if (!manifest) {
+		await emptyDir(config.get('paths:frames'));
+	}
+
+	await spawnSegmentedCapture(context, manifest);
+}
+
+export async function encode(context: IContext) {
+	const { config } = context;
+
+	if (config.get('capture:output') === 'pipe') {
+		throw new Error(
+			'Capture output "pipe" encodes while capturing, there is nothing to encode.'
+		);
+	}
+
+	await spawn(
+		config.get('tools:ffmpeg'),
+		getEncodeArgs(context, await getAudioFilename(context))
+	);
 }
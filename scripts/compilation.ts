@@ -3,12 +3,35 @@ import { join, sep } from 'path';
 import { IContext, IDemoDefinition } from './definitions';
 import { spawn } from './lib';
 
+// Headless builds are compiled and linked at once, with the standard library.
+function compileHeadless(context: IContext, demo: IDemoDefinition) {
+	const { config } = context;
+
+	return spawn(
+		config.get('tools:cxx'),
+		config
+			.get('cxx:args')
+			.concat(['-DHEADLESS', '-o', config.get('paths:exe')])
+			.concat(
+				Object.keys(demo.compilation.cpp.sources).map(
+					(obj) => demo.compilation.cpp.sources[obj].source
+				)
+			)
+			.concat(config.get('cxx:libs'))
+	);
+}
+
 export async function compile(context: IContext, demo: IDemoDefinition) {
 	const { config } = context;
 	const { compilation } = demo;
 	const buildDirectory: string = config.get('paths:build');
 	const demoDirectory: string = config.get('directory');
 
+	if (config.get('headless')) {
+		await compileHeadless(context, demo);
+		return;
+	}
+
 	let outArgs = ['/OUT:' + config.get('paths:exe')];
 
 	/*
@@ -136,7 +159,7 @@ export async function compile(context: IContext, demo: IDemoDefinition) {
 			.concat(Object.keys(compilation.asm.sources))
 			.concat(Object.keys(compilation.cpp.sources));
 
-		return config.get('debug')
+		return config.get('debug') || config.get('profile')
 			? spawn(
 					'link',
 					compilation.linkArgs
@@ -1,7 +1,7 @@
 import { pathExistsSync, statSync } from 'fs-extra';
 import { Provider } from 'nconf';
 import * as yaml from 'nconf-yaml';
-import { dirname, join } from 'path';
+import { dirname, join, resolve } from 'path';
 
 import { VierKlangAudioSynthesizer } from './audio-synthesizers/4klang';
 import { AchtKlangAudioSynthesizer } from './audio-synthesizers/8klang';
@@ -21,6 +21,7 @@ import { SynthclipseShaderProvider } from './shader-providers/synthclipse';
 export function provideContext(options: IContextOptions): IContext {
 	const config = new Provider();
 
+	config.set('benchmark', options.benchmark);
 	config.set('capture', options.capture);
 
 	config
@@ -37,6 +38,10 @@ export function provideContext(options: IContextOptions): IContext {
 				default: 'demo',
 				type: 'string',
 			},
+			headless: {
+				default: false,
+				type: 'boolean',
+			},
 			minify: {
 				alias: 'm',
 				default: true,
@@ -47,6 +52,16 @@ export function provideContext(options: IContextOptions): IContext {
 				default: false,
 				type: 'boolean',
 			},
+			profile: {
+				alias: 'p',
+				default: false,
+				type: 'boolean',
+			},
+			resume: {
+				alias: 'r',
+				default: false,
+				type: 'boolean',
+			},
 			server: {
 				alias: 's',
 				default: true,
@@ -122,13 +137,28 @@ export function provideContext(options: IContextOptions): IContext {
 			capture: {
 				fps: 60,
 				height: 1080,
+				output: 'frames',
+				pboCount: 0,
+				pixelFormat: 'rgb24',
+				segments: 1,
+				shutterAngle: 180,
+				subframes: 1,
+				supersampling: 1,
+				tileSize: 0,
 				width: 1920,
+				writerBuffers: 8,
+				writerThreads: 0,
 			},
 		});
 
 		config.set('forceResolution', true);
 	}
 
+	if (options.benchmark) {
+		// The benchmark task forces each resolution in turn.
+		config.set('forceResolution', true);
+	}
+
 	let shaderProvider: IShaderProvider;
 	switch (config.get('demo:shader-provider:tool') || 'simple') {
 		case 'simple':
@@ -156,6 +186,14 @@ export function provideContext(options: IContextOptions): IContext {
 	}
 
 	config.defaults({
+		benchmark: {
+			// end
+			fps: 60,
+			resolutions: [{ height: 1080, width: 1920 }],
+			start: 0,
+			warmupFrames: 10,
+			window: 1,
+		},
 		cl: {
 			args: config.get('debug')
 				? ['/EHsc']
@@ -176,18 +214,40 @@ export function provideContext(options: IContextOptions): IContext {
 				'user32.lib',
 			],
 		},
+		cxx: {
+			args: ['-O2', '-std=c++14', '-Wno-unknown-pragmas'],
+			libs: ['-lEGL', '-lOpenGL', '-lpthread'],
+		},
 		demo: {
 			'audio-synthesizer': Object.assign(
 				{},
 				audioSynthesizer && audioSynthesizer.getDefaultConfig()
 			),
+			audioAnalysis: false,
+			checkGLError: false,
+			checkerboard: {
+				cuts: [],
+				// interleave
+				maxTimeStep: 0.1,
+			},
 			closeWhenFinished: false,
+			dynamicResolution: {
+				// budget
+				decreaseFrames: 3,
+				headroom: 0.75,
+				increaseFrames: 30,
+				minScale: 0.5,
+			},
 			gl: {
 				constants: [],
 				functions: [],
 			},
+			glState: false,
 			hooks: 'hooks.cpp',
 			loadingBlackScreen: false,
+			parallelShaderCompile: false,
+			// renderGraph
+			uniformBlock: false,
 			// name
 			resolution: {
 				// height
@@ -216,10 +276,21 @@ export function provideContext(options: IContextOptions): IContext {
 			get dist() {
 				return dirname(config.get('paths:exe'));
 			},
-			exe: join('dist', config.get('demo:name') + '.exe'),
+			exe: join(
+				'dist',
+				config.get('demo:name') + (config.get('headless') ? '' : '.exe')
+			),
 			get frames() {
 				return join(config.get('paths:build'), 'frames');
 			},
+			// Not in the build directory, which is emptied at each build.
+			programCache: 'program-cache',
+		},
+		profiler: {
+			get filename() {
+				return resolve(config.get('paths:build'), 'profile.csv');
+			},
+			latency: 4,
 		},
 		server: {
 			port: 3000,
@@ -229,6 +300,7 @@ export function provideContext(options: IContextOptions): IContext {
 			'7z': '7z',
 			// 8klang
 			crinkler: 'crinkler',
+			cxx: 'g++',
 			ffmpeg: 'ffmpeg',
 			// glew
 			mono: 'mono',
@@ -238,22 +310,253 @@ export function provideContext(options: IContextOptions): IContext {
 		},
 	});
 
-	config.required([
-		'cl:args',
-		'demo:name',
-		'paths:build',
-		'paths:exe',
-		'tools:glew',
-	]);
+	config.required(['demo:name', 'paths:build', 'paths:exe']);
+
+	if (config.get('headless')) {
+		config.required(['cxx:args', 'cxx:libs', 'tools:cxx']);
+
+		if (config.get('debug')) {
+			throw new Error('Headless builds are not available in debug mode.');
+		}
+
+		if (!config.get('forceResolution')) {
+			throw new Error(
+				'Headless builds need demo:resolution:width and demo:resolution:height.'
+			);
+		}
+
+		if (!config.get('demo:duration')) {
+			throw new Error('Headless builds need demo:duration.');
+		}
+
+		if (
+			audioSynthesizer &&
+			!(audioSynthesizer instanceof RealtimeAudioSynthesizer)
+		) {
+			throw new Error('Headless builds do not play audio.');
+		}
+	} else {
+		config.required(['cl:args', 'tools:glew']);
+	}
 
 	if (options.capture) {
 		config.required(['paths:frames', 'tools:ffmpeg']);
+
+		switch (config.get('capture:output')) {
+			case 'frames':
+			case 'stream':
+				break;
+
+			case 'pipe':
+				if (config.get('debug')) {
+					throw new Error(
+						'Capture output "pipe" is not available in debug mode, as debug messages are written on the standard output.'
+					);
+				}
+				if (config.get('capture:writerThreads') > 1) {
+					throw new Error(
+						'Capture output "pipe" needs frames in order, use at most one writer thread.'
+					);
+				}
+				if (config.get('capture:segments') > 1) {
+					throw new Error(
+						'Capture output "pipe" needs frames in order, use a single segment.'
+					);
+				}
+				break;
+
+			default:
+				throw new Error('Config key "capture:output" is not valid.');
+		}
+
+		const segmentCount = config.get('capture:segments');
+		if (!Number.isInteger(segmentCount) || segmentCount < 1) {
+			throw new Error('Config key "capture:segments" is not valid.');
+		}
+
+		const subframeCount = config.get('capture:subframes');
+		if (!Number.isInteger(subframeCount) || subframeCount < 1) {
+			throw new Error('Config key "capture:subframes" is not valid.');
+		}
+
+		const shutterAngle = config.get('capture:shutterAngle');
+		if (!(shutterAngle > 0 && shutterAngle <= 360)) {
+			throw new Error('Config key "capture:shutterAngle" is not valid.');
+		}
+
+		const supersampling = config.get('capture:supersampling');
+		if (!Number.isInteger(supersampling) || supersampling < 1) {
+			throw new Error('Config key "capture:supersampling" is not valid.');
+		}
+
+		const tileSize = config.get('capture:tileSize');
+		if (!Number.isInteger(tileSize) || tileSize < 0) {
+			throw new Error('Config key "capture:tileSize" is not valid.');
+		}
+
+		switch (config.get('capture:pixelFormat')) {
+			case 'rgb24':
+				break;
+
+			case 'yuv420p':
+				if (
+					config.get('capture:width') % 2 !== 0 ||
+					config.get('capture:height') % 2 !== 0
+				) {
+					throw new Error(
+						'Capture pixel format "yuv420p" needs an even width and height.'
+					);
+				}
+				break;
+
+			default:
+				throw new Error('Config key "capture:pixelFormat" is not valid.');
+		}
+
+		if (!audioSynthesizer && !config.get('demo:duration')) {
+			console.warn(
+				'demo:duration has not been set, capture relies on an audio_duration hook.'
+			);
+		}
 	}
 
-	if (config.get('debug')) {
-		config.required(['link:args']);
-	} else {
-		config.required(['crinkler:args', 'tools:crinkler']);
+	if (options.benchmark) {
+		const fps = config.get('benchmark:fps');
+		if (!(fps > 0)) {
+			throw new Error('Config key "benchmark:fps" is not valid.');
+		}
+
+		const resolutions = config.get('benchmark:resolutions');
+		if (
+			!Array.isArray(resolutions) ||
+			resolutions.length === 0 ||
+			resolutions.some(
+				(resolution) =>
+					!Number.isInteger(resolution.width) ||
+					!Number.isInteger(resolution.height) ||
+					resolution.width < 1 ||
+					resolution.height < 1
+			)
+		) {
+			throw new Error('Config key "benchmark:resolutions" is not valid.');
+		}
+
+		if (!(config.get('benchmark:start') >= 0)) {
+			throw new Error('Config key "benchmark:start" is not valid.');
+		}
+
+		const warmupFrameCount = config.get('benchmark:warmupFrames');
+		if (!Number.isInteger(warmupFrameCount) || warmupFrameCount < 0) {
+			throw new Error('Config key "benchmark:warmupFrames" is not valid.');
+		}
+
+		if (!(config.get('benchmark:window') > 0)) {
+			throw new Error('Config key "benchmark:window" is not valid.');
+		}
+
+		if (
+			!audioSynthesizer &&
+			!config.get('demo:duration') &&
+			!config.get('benchmark:end')
+		) {
+			console.warn(
+				'Neither demo:duration nor benchmark:end has been set, benchmark relies on an audio_duration hook.'
+			);
+		}
+	}
+
+	// Captures and benchmarks render every frame at the full resolution.
+	if (
+		config.get('demo:dynamicResolution:budget') > 0 &&
+		!options.benchmark &&
+		!options.capture
+	) {
+		if (config.get('forceResolution')) {
+			throw new Error(
+				'Dynamic resolution needs the resolution uniforms, do not force demo:resolution.'
+			);
+		}
+
+		if (config.get('demo:renderGraph')) {
+			throw new Error(
+				'Dynamic resolution does not support demo:renderGraph, its targets have a fixed size.'
+			);
+		}
+
+		const minScale = config.get('demo:dynamicResolution:minScale');
+		if (!(minScale >= 0.25 && minScale <= 1)) {
+			throw new Error(
+				'Config key "demo:dynamicResolution:minScale" is not valid.'
+			);
+		}
+
+		const headroom = config.get('demo:dynamicResolution:headroom');
+		if (!(headroom > 0 && headroom < 1)) {
+			throw new Error(
+				'Config key "demo:dynamicResolution:headroom" is not valid.'
+			);
+		}
+
+		['decreaseFrames', 'increaseFrames'].forEach((key) => {
+			const frameCount = config.get('demo:dynamicResolution:' + key);
+			if (!Number.isInteger(frameCount) || frameCount < 1) {
+				throw new Error(
+					`Config key "demo:dynamicResolution:${key}" is not valid.`
+				);
+			}
+		});
+
+		config.set('dynamicResolution', true);
+	}
+
+	// Captures render every pixel of every frame.
+	if (config.get('demo:checkerboard:interleave') && !options.capture) {
+		if (config.get('dynamicResolution')) {
+			throw new Error(
+				'Checkerboard rendering is not available with dynamic resolution.'
+			);
+		}
+
+		const interleave = config.get('demo:checkerboard:interleave');
+		if (interleave !== 2 && interleave !== 4) {
+			throw new Error(
+				'Config key "demo:checkerboard:interleave" is not valid.'
+			);
+		}
+
+		if (!(config.get('demo:checkerboard:maxTimeStep') > 0)) {
+			throw new Error(
+				'Config key "demo:checkerboard:maxTimeStep" is not valid.'
+			);
+		}
+
+		const cuts = config.get('demo:checkerboard:cuts');
+		if (
+			!Array.isArray(cuts) ||
+			cuts.some((cut) => typeof cut !== 'number' || cut < 0)
+		) {
+			throw new Error('Config key "demo:checkerboard:cuts" is not valid.');
+		}
+
+		config.set('checkerboard', true);
+	}
+
+	if (config.get('profile')) {
+		config.required(['profiler:filename', 'profiler:latency']);
+
+		const latency = config.get('profiler:latency');
+		if (!Number.isInteger(latency) || latency < 1) {
+			throw new Error('Config key "profiler:latency" is not valid.');
+		}
+	}
+
+	if (!config.get('headless')) {
+		// Profile builds need the C runtime for their statistics.
+		if (config.get('debug') || config.get('profile')) {
+			config.required(['link:args']);
+		} else {
+			config.required(['crinkler:args', 'tools:crinkler']);
+		}
 	}
 
 	if (config.get('zip')) {
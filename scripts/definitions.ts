@@ -1,4 +1,5 @@
 export interface IContextOptions {
+	benchmark?: boolean;
 	capture?: boolean;
 	debug?: boolean;
 }
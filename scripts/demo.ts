@@ -8,6 +8,7 @@ import {
 	Variable,
 } from './definitions';
 import { addHooks } from './hooks';
+import { addRenderGraph } from './render-graph';
 import { addConstant } from './variables';
 
 export async function provideDemo(context: IContext): Promise<IDemoDefinition> {
@@ -18,17 +19,19 @@ export async function provideDemo(context: IContext): Promise<IDemoDefinition> {
 	const variables: Variable[] = [];
 
 	if (config.get('capture')) {
+		// Supersampled frames are rendered at a higher resolution, then downsampled.
+		const supersampling = config.get('capture:supersampling');
 		addConstant(
 			variables,
 			'float',
 			'resolutionWidth',
-			config.get('capture:width')
+			config.get('capture:width') * supersampling
 		);
 		addConstant(
 			variables,
 			'float',
 			'resolutionHeight',
-			config.get('capture:height')
+			config.get('capture:height') * supersampling
 		);
 	} else {
 		if (
@@ -205,8 +208,15 @@ export async function provideDemo(context: IContext): Promise<IDemoDefinition> {
 		Object.keys(shader.uniformArrays)
 			.map((type) => {
 				const uniformArray = shader.uniformArrays[type];
-				return `uniform ${type} ${uniformArray.minifiedName ||
+				const declaration = `${type} ${uniformArray.minifiedName ||
 					uniformArray.name}[${uniformArray.variables.length}];`;
+
+				// Shared by all programs, see engine/uniform-block.hpp.
+				if (type === 'float' && config.get('demo:uniformBlock')) {
+					return `layout(std140) uniform Uniforms{${declaration}};`;
+				}
+
+				return 'uniform ' + declaration;
 			})
 			.concat(
 				Object.keys(globalsByTypes).map((type) => {
@@ -244,6 +254,12 @@ export async function provideDemo(context: IContext): Promise<IDemoDefinition> {
 			source: join('engine', 'debug.cpp'),
 		};
 
+		if (config.get('paths:programCache')) {
+			compilation.cpp.sources[join(buildDirectory, 'program-cache.obj')] = {
+				source: join('engine', 'program-cache.cpp'),
+			};
+		}
+
 		if (config.get('server')) {
 			compilation.cpp.sources[join(buildDirectory, 'server.obj')] = {
 				source: join('engine', 'server.cpp'),
@@ -256,6 +272,17 @@ export async function provideDemo(context: IContext): Promise<IDemoDefinition> {
 		await addHooks(compilation.cpp.hooks, join('engine', 'capture-hooks.cpp'));
 	}
 
+	if (config.get('benchmark')) {
+		await addHooks(
+			compilation.cpp.hooks,
+			join('engine', 'benchmark-hooks.cpp')
+		);
+	}
+
+	if (config.get('demo:renderGraph')) {
+		addRenderGraph(config, compilation.cpp.hooks, shader.passes.length);
+	}
+
 	if (context.audioSynthesizer) {
 		await context.audioSynthesizer.addToCompilation(compilation);
 	}
@@ -271,6 +298,20 @@ export async function provideDemo(context: IContext): Promise<IDemoDefinition> {
 		}
 	}
 
+	// Synthesizers and demos which can render offline give the music to the capture.
+	if (config.get('capture') && compilation.cpp.hooks.audio_render) {
+		if (config.get('capture:output') === 'pipe') {
+			console.warn(
+				'The pipe output is encoded while capturing, before the music is rendered, it uses capture:audioFilename instead.'
+			);
+		} else {
+			await addHooks(
+				compilation.cpp.hooks,
+				join('engine', 'capture-audio-hooks.cpp')
+			);
+		}
+	}
+
 	return {
 		compilation,
 		shader,
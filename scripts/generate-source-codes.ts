@@ -1,9 +1,11 @@
 import { readFile, writeFile } from 'fs-extra';
-import { join } from 'path';
+import { join, resolve } from 'path';
 
 import { IContext, IDemoDefinition } from './definitions';
 import { replaceHooks } from './hooks';
 import { forEachMatch } from './lib';
+import { renderGraphFormats } from './render-graph';
+import { getUniformMacroName } from './variables';
 
 export async function writeDemoData(context: IContext, demo: IDemoDefinition) {
 	const buildDirectory: string = context.config.get('paths:build');
@@ -20,6 +22,20 @@ export async function writeDemoData(context: IContext, demo: IDemoDefinition) {
 	if (context.config.get('debug')) {
 		fileContents.push('#define DEBUG', '');
 
+		if (context.config.get('demo:checkGLError')) {
+			fileContents.push('#define DEBUG_CHECK_GL_ERROR', '');
+		}
+
+		const programCacheDirectory = context.config.get('paths:programCache');
+		if (programCacheDirectory) {
+			fileContents.push(
+				'#define PROGRAM_CACHE',
+				'#define PROGRAM_CACHE_DIRECTORY ' +
+					JSON.stringify(resolve(programCacheDirectory)),
+				''
+			);
+		}
+
 		if (context.config.get('server')) {
 			fileContents.push(
 				'#define SERVER',
@@ -48,10 +64,9 @@ export async function writeDemoData(context: IContext, demo: IDemoDefinition) {
 		);
 
 		uniformArray.variables.forEach((variable, index) => {
-			const name = variable.name
-				.replace(/^\w|\b\w/g, (letter) => letter.toUpperCase())
-				.replace(/_+/g, '');
-			fileContents.push(`#define uniform${name} ${arrayName}[${index}]`);
+			fileContents.push(
+				`#define ${getUniformMacroName(variable.name)} ${arrayName}[${index}]`
+			);
 		});
 
 		fileContents.push('');
@@ -163,9 +178,32 @@ export async function writeDemoData(context: IContext, demo: IDemoDefinition) {
 	}
 
 	if (context.config.get('capture')) {
+		const writerBufferCount = context.config.get('capture:writerBuffers');
+		const writerThreadCount = context.config.get('capture:writerThreads');
+
+		// Room for every buffer, plus the stop signal of every thread.
+		let writerQueueSize = 1;
+		while (writerQueueSize < writerBufferCount + writerThreadCount) {
+			writerQueueSize *= 2;
+		}
+
 		fileContents.push(
 			'#define CAPTURE',
 			'#define CAPTURE_FPS ' + context.config.get('capture:fps'),
+			'#define CAPTURE_OUTPUT_' +
+				context.config.get('capture:output').toUpperCase(),
+			'#define CAPTURE_PBO_COUNT ' + context.config.get('capture:pboCount'),
+			'#define CAPTURE_PIXEL_FORMAT_' +
+				context.config.get('capture:pixelFormat').toUpperCase(),
+			'#define CAPTURE_SHUTTER_ANGLE ' +
+				context.config.get('capture:shutterAngle'),
+			'#define CAPTURE_SUBFRAME_COUNT ' + context.config.get('capture:subframes'),
+			'#define CAPTURE_SUPERSAMPLING ' +
+				context.config.get('capture:supersampling'),
+			'#define CAPTURE_TILE_SIZE ' + context.config.get('capture:tileSize'),
+			'#define CAPTURE_WRITER_BUFFER_COUNT ' + writerBufferCount,
+			'#define CAPTURE_WRITER_QUEUE_SIZE ' + writerQueueSize,
+			'#define CAPTURE_WRITER_THREAD_COUNT ' + writerThreadCount,
 			'#define FORCE_RESOLUTION',
 			'static const constexpr int resolutionWidth = ' +
 				context.config.get('capture:width') +
@@ -205,14 +243,105 @@ export async function writeDemoData(context: IContext, demo: IDemoDefinition) {
 		fileContents.push(`#define DURATION ${duration}`, '');
 	}
 
+	if (context.config.get('benchmark')) {
+		fileContents.push(
+			'#define BENCHMARK',
+			'#define BENCHMARK_FPS ' + context.config.get('benchmark:fps'),
+			'#define BENCHMARK_START ' + context.config.get('benchmark:start'),
+			'#define BENCHMARK_WARMUP_FRAMES ' +
+				context.config.get('benchmark:warmupFrames')
+		);
+
+		const end = context.config.get('benchmark:end');
+		if (end) {
+			fileContents.push('#define BENCHMARK_END ' + end);
+		}
+
+		fileContents.push('');
+	}
+
 	if (
 		duration ||
+		context.config.get('benchmark') ||
 		context.config.get('capture') ||
 		context.config.get('demo:closeWhenFinished')
 	) {
 		fileContents.push('#define CLOSE_WHEN_FINISHED', '');
 	}
 
+	if (context.config.get('dynamicResolution')) {
+		// Timings are compared in nanoseconds, the scale is a number of sixteenths.
+		const budget = context.config.get('demo:dynamicResolution:budget') * 1e6;
+		fileContents.push(
+			'#define DYNAMIC_RESOLUTION',
+			'#define DYNAMIC_RESOLUTION_BUDGET ' + Math.round(budget),
+			'#define DYNAMIC_RESOLUTION_DECREASE_FRAMES ' +
+				context.config.get('demo:dynamicResolution:decreaseFrames'),
+			'#define DYNAMIC_RESOLUTION_HEADROOM ' +
+				Math.round(
+					budget * context.config.get('demo:dynamicResolution:headroom')
+				),
+			'#define DYNAMIC_RESOLUTION_INCREASE_FRAMES ' +
+				context.config.get('demo:dynamicResolution:increaseFrames'),
+			'#define DYNAMIC_RESOLUTION_MIN_LEVEL ' +
+				Math.ceil(
+					context.config.get('demo:dynamicResolution:minScale') * 16
+				),
+			''
+		);
+	}
+
+	if (context.config.get('checkerboard')) {
+		fileContents.push(
+			'#define CHECKERBOARD',
+			'#define CHECKERBOARD_INTERLEAVE ' +
+				context.config.get('demo:checkerboard:interleave'),
+			'#define CHECKERBOARD_MAX_TIME_STEP ' +
+				context.config.get('demo:checkerboard:maxTimeStep')
+		);
+
+		const cuts: number[] = context.config.get('demo:checkerboard:cuts');
+		if (cuts.length > 0) {
+			fileContents.push('#define CHECKERBOARD_CUTS ' + cuts.join(', '));
+		}
+
+		fileContents.push('');
+	}
+
+	if (context.config.get('profile')) {
+		fileContents.push(
+			'#define PROFILE',
+			'#define PROFILE_FILENAME ' +
+				JSON.stringify(context.config.get('profiler:filename')),
+			'#define PROFILE_LATENCY ' + context.config.get('profiler:latency'),
+			''
+		);
+	}
+
+	// A single program has nothing to compile in parallel.
+	if (
+		context.config.get('demo:parallelShaderCompile') &&
+		demo.shader.passes.length > 1
+	) {
+		fileContents.push('#define PARALLEL_SHADER_COMPILE', '');
+	}
+
+	if (context.config.get('demo:uniformBlock')) {
+		fileContents.push('#define UNIFORM_BLOCK', '');
+	}
+
+	if (context.config.get('demo:glState')) {
+		fileContents.push('#define GL_STATE', '');
+	}
+
+	// Headless builds have no audio, analyzed uniforms stay at 0.
+	if (
+		context.config.get('demo:audioAnalysis') &&
+		!context.config.get('headless')
+	) {
+		fileContents.push('#define AUDIO_ANALYSIS', '');
+	}
+
 	if (context.config.get('demo:loadingBlackScreen')) {
 		fileContents.push('#define LOADING_BLACK_SCREEN', '');
 	}
@@ -227,7 +356,7 @@ export async function writeDemoData(context: IContext, demo: IDemoDefinition) {
 	);
 }
 
-export async function writeDemoGl(context: IContext) {
+export async function writeDemoGl(context: IContext, demo: IDemoDefinition) {
 	const fileContents = [
 		'#pragma once',
 		'',
@@ -237,6 +366,8 @@ export async function writeDemoGl(context: IContext) {
 		'typedef char GLchar;',
 		'typedef ptrdiff_t GLintptr;',
 		'typedef ptrdiff_t GLsizeiptr;',
+		'typedef unsigned __int64 GLuint64;',
+		'typedef struct __GLsync *GLsync;',
 		'typedef void (APIENTRY * GLDEBUGPROC)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,const GLchar * message,const void * userParam);',
 		'',
 	];
@@ -276,6 +407,187 @@ export async function writeDemoGl(context: IContext) {
 	addFromConfig('demo:gl:constants', addGlConstantName);
 	addFromConfig('demo:gl:functions', addGlFunctionName);
 
+	if (
+		context.config.get('demo:parallelShaderCompile') &&
+		demo.shader.passes.length > 1
+	) {
+		addGlFunctionName('glMaxShaderCompilerThreadsKHR');
+	}
+
+	if (context.config.get('demo:uniformBlock')) {
+		[
+			'GL_MAP_FLUSH_EXPLICIT_BIT',
+			'GL_MAP_PERSISTENT_BIT',
+			'GL_MAP_WRITE_BIT',
+			'GL_SYNC_FLUSH_COMMANDS_BIT',
+			'GL_SYNC_GPU_COMMANDS_COMPLETE',
+			'GL_UNIFORM_BUFFER',
+			'GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT',
+		].forEach(addGlConstantName);
+		[
+			'glBindBuffer',
+			'glBindBufferRange',
+			'glBufferStorage',
+			'glClientWaitSync',
+			'glDeleteSync',
+			'glFenceSync',
+			'glFlushMappedBufferRange',
+			'glGenBuffers',
+			'glMapBufferRange',
+		].forEach(addGlFunctionName);
+	}
+
+	// Capture builds are not released, size does not matter.
+	if (context.config.get('capture')) {
+		[
+			'GL_COLOR_ATTACHMENT0',
+			'GL_CONSTANT_ALPHA',
+			'GL_CURRENT_PROGRAM',
+			'GL_FRAMEBUFFER',
+			'GL_PIXEL_PACK_BUFFER',
+			'GL_R8',
+			'GL_READ_ONLY',
+			'GL_RGBA32F',
+			'GL_STREAM_READ',
+			'GL_TEXTURE0',
+		].forEach(addGlConstantName);
+		[
+			'glActiveTexture',
+			'glBindBuffer',
+			'glBindFramebuffer',
+			'glBlendColor',
+			'glBufferData',
+			'glFramebufferTexture2D',
+			'glGenBuffers',
+			'glGenFramebuffers',
+			'glMapBuffer',
+			'glUnmapBuffer',
+		].forEach(addGlFunctionName);
+	}
+
+	if (context.config.get('dynamicResolution')) {
+		[
+			'GL_COLOR_ATTACHMENT0',
+			'GL_DRAW_FRAMEBUFFER',
+			'GL_FRAMEBUFFER',
+			'GL_QUERY_RESULT',
+			'GL_QUERY_RESULT_AVAILABLE',
+			'GL_TIME_ELAPSED',
+		].forEach(addGlConstantName);
+		[
+			'glBeginQuery',
+			'glBindFramebuffer',
+			'glBlitFramebuffer',
+			'glEndQuery',
+			'glFramebufferTexture2D',
+			'glGenFramebuffers',
+			'glGenQueries',
+			'glGetQueryObjectuiv',
+		].forEach(addGlFunctionName);
+	}
+
+	// The loading bar, displayed while the synthesizer renders ahead of the playback.
+	if (demo.compilation.cpp.hooks['audio_loading_progress']) {
+		addGlConstantName('GL_CURRENT_PROGRAM');
+	}
+
+	if (context.config.get('demo:audioAnalysis')) {
+		addGlConstantName('GL_R32F');
+		[
+			'glBindTextureUnit',
+			'glCreateTextures',
+			'glGetUniformLocation',
+			'glProgramUniform1i',
+			'glTextureParameteri',
+			'glTextureStorage2D',
+			'glTextureSubImage2D',
+		].forEach(addGlFunctionName);
+	}
+
+	if (context.config.get('demo:glState')) {
+		['GL_FRAMEBUFFER', 'GL_TEXTURE0'].forEach(addGlConstantName);
+		['glActiveTexture', 'glBindFramebuffer', 'glBindVertexArray'].forEach(
+			addGlFunctionName
+		);
+	}
+
+	const renderGraphTargets = context.config.get('demo:renderGraph:targets');
+	if (renderGraphTargets) {
+		['GL_COLOR_ATTACHMENT0', 'GL_FRAMEBUFFER', 'GL_TEXTURE0'].forEach(
+			addGlConstantName
+		);
+		[
+			'glActiveTexture',
+			'glBindFramebuffer',
+			'glFramebufferTexture2D',
+			'glGenFramebuffers',
+			'glGetUniformLocation',
+			'glTexStorage2D',
+			'glUniform1iv',
+		].forEach(addGlFunctionName);
+
+		const renderGraphPasses = context.config.get('demo:renderGraph:passes');
+		if (
+			Array.isArray(renderGraphPasses) &&
+			renderGraphPasses.some((pass) => pass.outputs && pass.outputs.length > 1)
+		) {
+			addGlFunctionName('glDrawBuffers');
+		}
+
+		if (
+			Array.isArray(renderGraphPasses) &&
+			renderGraphPasses.some((pass) => pass.draw && pass.draw.instances > 1)
+		) {
+			addGlFunctionName('glDrawArraysInstanced');
+		}
+
+		Object.keys(renderGraphTargets).forEach((name) => {
+			const format = renderGraphFormats[renderGraphTargets[name].format];
+			if (format && format.constant) {
+				addGlConstantName(format.constant);
+			}
+
+			if (renderGraphTargets[name].feedback) {
+				addGlFunctionName('glClearTexImage');
+			}
+		});
+	}
+
+	if (context.config.get('checkerboard')) {
+		[
+			'GL_COLOR_ATTACHMENT0',
+			'GL_DEPTH24_STENCIL8',
+			'GL_DEPTH_STENCIL_ATTACHMENT',
+			'GL_FRAMEBUFFER',
+			'GL_RENDERBUFFER',
+		].forEach(addGlConstantName);
+		[
+			'glBindFramebuffer',
+			'glBindRenderbuffer',
+			'glFramebufferRenderbuffer',
+			'glFramebufferTexture2D',
+			'glGenFramebuffers',
+			'glGenRenderbuffers',
+			'glGetUniformLocation',
+			'glRenderbufferStorage',
+			'glUniform1i',
+		].forEach(addGlFunctionName);
+	}
+
+	if (context.config.get('profile')) {
+		[
+			'GL_QUERY_RESULT',
+			'GL_QUERY_RESULT_AVAILABLE',
+			'GL_TIMESTAMP',
+		].forEach(addGlConstantName);
+		[
+			'glGenQueries',
+			'glGetQueryObjectui64v',
+			'glGetQueryObjectuiv',
+			'glQueryCounter',
+		].forEach(addGlFunctionName);
+	}
+
 	const glewContents = await readFile(
 		join(context.config.get('tools:glew'), 'include', 'GL', 'glew.h'),
 		'utf8'
@@ -294,20 +606,23 @@ export async function writeDemoGl(context: IContext) {
 
 	const glExtFunctionNames: string[] = [];
 
-	glFunctionNames.forEach((functionName, index) => {
+	// Missing functions get no entry, so that they cost no bytes.
+	glFunctionNames.forEach((functionName) => {
 		const typedefName = 'PFN' + functionName.toUpperCase() + 'PROC';
 		const match = glewContents.match(
-			new RegExp(`^typedef \\w+ \\(GLAPIENTRY \\* ${typedefName}\\).+$`, 'gm')
+			new RegExp(
+				`^typedef [\\w *]+ \\(GLAPIENTRY \\* ${typedefName}\\).+$`,
+				'gm'
+			)
 		);
 		if (match) {
 			fileContents.push(
 				match[0],
-				`#define ${functionName} ((${typedefName})glExtFunctions[${index}])`
+				`#define ${functionName} ((${typedefName})glExtFunctions[${glExtFunctionNames.length}])`
 			);
 			glExtFunctionNames.push(`"${functionName}"`);
 		} else {
 			console.warn(`OpenGL function ${functionName} does not seem to exist.`);
-			glExtFunctionNames.push(`0`);
 		}
 	});
 
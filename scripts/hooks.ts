@@ -34,7 +34,7 @@ export async function addHooks(hooks: IHooks, path: string) {
 export function replaceHooks(hooks: IHooks, str: string): string {
 	Object.keys(hooks).forEach((hookName) => {
 		str = str.replace(
-			new RegExp(`\\bREPLACE_HOOK_${hookName.toUpperCase()}`, 'g'),
+			new RegExp(`\\bREPLACE_HOOK_${hookName.toUpperCase()}\\b`, 'g'),
 			() => replaceHooks(hooks, hooks[hookName])
 		);
 	});
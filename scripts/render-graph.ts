@@ -0,0 +1,616 @@
+import { IConfig, IHooks } from './definitions';
+import { getUniformMacroName } from './variables';
+
+export interface IRenderGraphFormat {
+	// Constant not declared by GL/gl.h, if any.
+	constant?: string;
+	internalFormat: string;
+}
+
+export const renderGraphFormats: { [name: string]: IRenderGraphFormat } = {
+	r11g11b10f: {
+		constant: 'GL_R11F_G11F_B10F',
+		internalFormat: 'GL_R11F_G11F_B10F',
+	},
+	rgba16f: { constant: 'GL_RGBA16F', internalFormat: 'GL_RGBA16F' },
+	rgba32f: { constant: 'GL_RGBA32F', internalFormat: 'GL_RGBA32F' },
+	rgba8: { internalFormat: 'GL_RGBA8' },
+};
+
+// Blending of a pass output with the previous content of its targets.
+const renderGraphBlendFunctions: { [name: string]: string } = {
+	additive: 'GL_ONE, GL_ONE',
+	alpha: 'GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA',
+};
+
+const renderGraphDrawModes: { [name: string]: string } = {
+	lineStrip: 'GL_LINE_STRIP',
+	lines: 'GL_LINES',
+	points: 'GL_POINTS',
+	triangleFan: 'GL_TRIANGLE_FAN',
+	triangleStrip: 'GL_TRIANGLE_STRIP',
+	triangles: 'GL_TRIANGLES',
+};
+
+interface IRenderGraphTarget {
+	divisor: number;
+	feedback: boolean;
+	filter: string;
+	format: string;
+}
+
+// Vertices are not read from buffers,
+// the vertex shader computes them from gl_VertexID and gl_InstanceID.
+interface IRenderGraphDraw {
+	count: number;
+	instances: number;
+	mode: string;
+}
+
+interface IRenderGraphPass {
+	blend?: string;
+	clear: boolean;
+	draw?: IRenderGraphDraw;
+	inputs: string[];
+	outputs: string[];
+}
+
+interface ITargetLifetime {
+	first: number;
+	last: number;
+	name: string;
+}
+
+interface IPhysicalTexture extends IRenderGraphTarget {
+	// Index of the first texture, feedback targets have two.
+	base: number;
+	last: number;
+	names: string[];
+}
+
+function getTargets(config: IConfig) {
+	const targets: { [name: string]: IRenderGraphTarget } = {};
+
+	const targetsConfig = config.get('demo:renderGraph:targets') || {};
+	Object.keys(targetsConfig).forEach((name) => {
+		const target = Object.assign(
+			{ divisor: 1, feedback: false, filter: 'linear', format: 'rgba8' },
+			targetsConfig[name]
+		);
+
+		if (!/^[A-Za-z_]\w*$/.test(name)) {
+			throw new Error(`Render graph target "${name}" is not a valid name.`);
+		}
+
+		if (!renderGraphFormats[target.format]) {
+			throw new Error(
+				`Config key "demo:renderGraph:targets:${name}:format" is not valid.`
+			);
+		}
+
+		if (!Number.isInteger(target.divisor) || target.divisor < 1) {
+			throw new Error(
+				`Config key "demo:renderGraph:targets:${name}:divisor" is not valid.`
+			);
+		}
+
+		if (typeof target.feedback !== 'boolean') {
+			throw new Error(
+				`Config key "demo:renderGraph:targets:${name}:feedback" is not valid.`
+			);
+		}
+
+		if (target.filter !== 'linear' && target.filter !== 'nearest') {
+			throw new Error(
+				`Config key "demo:renderGraph:targets:${name}:filter" is not valid.`
+			);
+		}
+
+		targets[name] = target;
+	});
+
+	return targets;
+}
+
+function getPasses(config: IConfig, passCount: number) {
+	const passesConfig = config.get('demo:renderGraph:passes');
+	if (!Array.isArray(passesConfig) || passesConfig.length !== passCount) {
+		throw new Error(
+			'Config key "demo:renderGraph:passes" should describe every shader pass.'
+		);
+	}
+
+	return passesConfig.map((passConfig, index) => {
+		const pass: IRenderGraphPass = Object.assign(
+			{ clear: false, inputs: [], outputs: [] },
+			passConfig
+		);
+
+		if (pass.blend && !renderGraphBlendFunctions[pass.blend]) {
+			throw new Error(
+				`Config key "demo:renderGraph:passes:${index}:blend" is not valid.`
+			);
+		}
+
+		if (pass.draw) {
+			const draw = Object.assign(
+				{ instances: 1, mode: 'triangles' },
+				pass.draw
+			);
+
+			if (!Number.isInteger(draw.count) || draw.count < 1) {
+				throw new Error(
+					`Config key "demo:renderGraph:passes:${index}:draw:count" is not valid.`
+				);
+			}
+
+			if (!Number.isInteger(draw.instances) || draw.instances < 1) {
+				throw new Error(
+					`Config key "demo:renderGraph:passes:${index}:draw:instances" is not valid.`
+				);
+			}
+
+			if (!renderGraphDrawModes[draw.mode]) {
+				throw new Error(
+					`Config key "demo:renderGraph:passes:${index}:draw:mode" is not valid.`
+				);
+			}
+
+			pass.draw = draw;
+		}
+
+		return pass;
+	});
+}
+
+function getDrawCall(draw?: IRenderGraphDraw) {
+	if (!draw) {
+		return 'glRects(-1, -1, 1, 1);';
+	}
+
+	const mode = renderGraphDrawModes[draw.mode];
+	return draw.instances > 1
+		? `glDrawArraysInstanced(${mode}, 0, ${draw.count}, ${draw.instances});`
+		: `glDrawArrays(${mode}, 0, ${draw.count});`;
+}
+
+// Targets live from the first pass writing them to the last pass using them.
+// Targets which are never alive at the same time share a texture, when they have the same format and size.
+// Feedback targets keep their content from a frame to the next one, they never share their textures.
+function allocateTextures(
+	targets: { [name: string]: IRenderGraphTarget },
+	passes: IRenderGraphPass[]
+) {
+	const lifetimes: { [name: string]: ITargetLifetime } = {};
+	const readNames: string[] = [];
+
+	passes.forEach((pass, index) => {
+		pass.inputs.forEach((name) => {
+			if (!targets[name]) {
+				throw new Error(
+					`Render graph pass ${index} reads unknown target "${name}".`
+				);
+			}
+
+			readNames.push(name);
+
+			if (targets[name].feedback) {
+				return;
+			}
+
+			if (!lifetimes[name]) {
+				throw new Error(
+					`Render graph pass ${index} reads target "${name}" before it is written.`
+				);
+			}
+
+			if (pass.outputs.indexOf(name) !== -1) {
+				throw new Error(
+					`Render graph pass ${index} reads and writes target "${name}".`
+				);
+			}
+
+			lifetimes[name].last = index;
+		});
+
+		pass.outputs.forEach((name) => {
+			if (!targets[name]) {
+				throw new Error(
+					`Render graph pass ${index} writes unknown target "${name}".`
+				);
+			}
+
+			if (lifetimes[name]) {
+				lifetimes[name].last = index;
+			} else {
+				lifetimes[name] = { first: index, last: index, name };
+			}
+		});
+
+		const divisors = pass.outputs.map((name) => targets[name].divisor);
+		if (divisors.some((divisor) => divisor !== divisors[0])) {
+			throw new Error(
+				`Render graph pass ${index} writes targets of different sizes.`
+			);
+		}
+	});
+
+	Object.keys(targets).forEach((name) => {
+		if (!lifetimes[name]) {
+			if (readNames.indexOf(name) !== -1) {
+				throw new Error(
+					`Render graph target "${name}" is read but never written.`
+				);
+			}
+
+			console.warn(`Render graph target "${name}" is never written.`);
+		} else if (readNames.indexOf(name) === -1) {
+			console.warn(`Render graph target "${name}" is never read.`);
+		}
+	});
+
+	const textures: IPhysicalTexture[] = [];
+	const textureIndices: { [name: string]: number } = {};
+
+	Object.keys(lifetimes)
+		.map((name) => lifetimes[name])
+		.sort((a, b) => a.first - b.first)
+		.forEach((lifetime) => {
+			const target = targets[lifetime.name];
+
+			let index = textures.findIndex(
+				(texture) =>
+					!target.feedback &&
+					!texture.feedback &&
+					texture.last < lifetime.first &&
+					texture.divisor === target.divisor &&
+					texture.filter === target.filter &&
+					texture.format === target.format
+			);
+
+			if (index === -1) {
+				index = textures.length;
+				textures.push(Object.assign({ base: 0, last: 0, names: [] }, target));
+			}
+
+			textures[index].last = lifetime.last;
+			textures[index].names.push(lifetime.name);
+			textureIndices[lifetime.name] = index;
+		});
+
+	let textureCount = 0;
+	textures.forEach((texture) => {
+		texture.base = textureCount;
+		textureCount += texture.feedback ? 2 : 1;
+	});
+
+	return { textureCount, textureIndices, textures };
+}
+
+function addToHook(hooks: IHooks, hookName: string, lines: string[]) {
+	hooks[hookName] = (hooks[hookName] || '') + lines.join('\n');
+}
+
+// The current texture of feedback targets is written, the previous one holds the previous frame.
+function getTexture(texture: IPhysicalTexture, previous = false) {
+	if (!texture.feedback) {
+		return `renderGraphTextures[${texture.base}]`;
+	}
+
+	const frame = previous ? '(renderGraphFrame ^ 1)' : 'renderGraphFrame';
+	return `renderGraphTextures[${
+		texture.base ? texture.base + ' + ' + frame : frame
+	}]`;
+}
+
+function getSize(divisor: number) {
+	return divisor === 1
+		? 'resolutionWidth, resolutionHeight'
+		: `resolutionWidth / ${divisor}, resolutionHeight / ${divisor}`;
+}
+
+// Generates the declarations, initialize and render hooks executing the graph.
+// The draw call of pass N can be replaced by a render_pass_N hook,
+// which is still wrapped by the blending state of the pass.
+// With demo:glState, bindings go through engine/gl-state.hpp.
+export function addRenderGraph(
+	config: IConfig,
+	hooks: IHooks,
+	passCount: number
+) {
+	if (passCount < 2) {
+		throw new Error('Render graph needs at least two shader passes.');
+	}
+
+	const targets = getTargets(config);
+	const passes = getPasses(config, passCount);
+	const { textureCount, textureIndices, textures } = allocateTextures(
+		targets,
+		passes
+	);
+	const hasFeedback = textures.some((texture) => texture.feedback);
+	const glState: boolean = config.get('demo:glState');
+
+	if (textures.length === 0) {
+		throw new Error('Render graph should write at least one target.');
+	}
+
+	// Passes writing feedback targets have a framebuffer for each frame parity.
+	const framebufferIndices = passes.map(() => -1);
+	const framebufferFeedbacks = passes.map((pass) =>
+		pass.outputs.some((name) => targets[name].feedback)
+	);
+	let framebufferCount = 0;
+	passes.forEach((pass, index) => {
+		if (pass.outputs.length > 0) {
+			framebufferIndices[index] = framebufferCount;
+			framebufferCount += framebufferFeedbacks[index] ? 2 : 1;
+		}
+	});
+
+	const declarations = [
+		'',
+		'// Generated from demo:renderGraph.',
+		'#define RENDER_GRAPH',
+		`#define RENDER_GRAPH_TEXTURE_COUNT ${textureCount}`,
+		`#define RENDER_GRAPH_FRAMEBUFFER_COUNT ${framebufferCount}`,
+		'',
+		'static GLuint renderGraphTextures[RENDER_GRAPH_TEXTURE_COUNT];',
+		'static GLuint renderGraphFramebuffers[RENDER_GRAPH_FRAMEBUFFER_COUNT];',
+		'',
+	];
+
+	if (hasFeedback) {
+		declarations.push(
+			'// Parity of the frame, which selects the current texture of feedback targets.',
+			'static int renderGraphFrame;',
+			''
+		);
+	}
+
+	const initialize = [
+		'',
+		'glGenTextures(RENDER_GRAPH_TEXTURE_COUNT, renderGraphTextures);',
+		'checkGLError();',
+		'',
+	];
+
+	textures.forEach((texture) => {
+		const filter = texture.filter === 'nearest' ? 'GL_NEAREST' : 'GL_LINEAR';
+		initialize.push(`// ${texture.names.join(', ')}`);
+
+		const copyCount = texture.feedback ? 2 : 1;
+		for (let copy = 0; copy < copyCount; ++copy) {
+			const index = texture.base + copy;
+			initialize.push(
+				`glBindTexture(GL_TEXTURE_2D, renderGraphTextures[${index}]);`,
+				'checkGLError();',
+				`glTexStorage2D(GL_TEXTURE_2D, 1, ${
+					renderGraphFormats[texture.format].internalFormat
+				}, ${getSize(texture.divisor)});`,
+				'checkGLError();',
+				`glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, ${filter});`,
+				'checkGLError();',
+				`glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, ${filter});`,
+				'checkGLError();'
+			);
+
+			// The first frame reads black.
+			if (texture.feedback) {
+				initialize.push(
+					`glClearTexImage(renderGraphTextures[${index}], 0, GL_RGBA, GL_FLOAT, 0);`,
+					'checkGLError();'
+				);
+			}
+		}
+
+		initialize.push('');
+	});
+
+	initialize.push(
+		'glGenFramebuffers(RENDER_GRAPH_FRAMEBUFFER_COUNT, renderGraphFramebuffers);',
+		'checkGLError();',
+		''
+	);
+
+	// Attachments never change, as aliasing is resolved at build time.
+	passes.forEach((pass, index) => {
+		if (framebufferIndices[index] === -1) {
+			return;
+		}
+
+		const frameCount = framebufferFeedbacks[index] ? 2 : 1;
+		for (let frame = 0; frame < frameCount; ++frame) {
+			const framebufferIndex = framebufferIndices[index] + frame;
+			initialize.push(
+				`glBindFramebuffer(GL_FRAMEBUFFER, renderGraphFramebuffers[${framebufferIndex}]);`,
+				'checkGLError();'
+			);
+
+			pass.outputs.forEach((name, attachment) => {
+				const texture = textures[textureIndices[name]];
+				const textureIndex = texture.base + (texture.feedback ? frame : 0);
+				initialize.push(
+					`glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + ${attachment}, GL_TEXTURE_2D, renderGraphTextures[${textureIndex}], 0);`,
+					'checkGLError();'
+				);
+			});
+
+			if (pass.outputs.length > 1) {
+				initialize.push(
+					'{',
+					`\tstatic const GLenum drawBuffers[] = { ${pass.outputs
+						.map((_, attachment) => `GL_COLOR_ATTACHMENT0 + ${attachment}`)
+						.join(', ')} };`,
+					`\tglDrawBuffers(${pass.outputs.length}, drawBuffers);`,
+					'\tcheckGLError();',
+					'}'
+				);
+			}
+
+			initialize.push('');
+		}
+	});
+
+	initialize.push(
+		'glBindFramebuffer(GL_FRAMEBUFFER, 0);',
+		'checkGLError();',
+		''
+	);
+
+	// Targets are sampled from the texture unit of their texture index.
+	Object.keys(textureIndices).forEach((name) => {
+		const macroName = getUniformMacroName(name);
+		initialize.push(
+			`#ifdef ${macroName}`,
+			`${macroName} = ${textureIndices[name]};`,
+			'#endif'
+		);
+	});
+
+	initialize.push(
+		'',
+		'#ifdef SAMPLER2D_UNIFORM_COUNT',
+		'for (auto i = 0; i < PASS_COUNT; ++i)',
+		'{',
+		'\tglUseProgram(programs[i]);',
+		'\tcheckGLError();',
+		'\tglUniform1iv(glGetUniformLocation(programs[i], SAMPLER2D_UNIFORM_NAME), SAMPLER2D_UNIFORM_COUNT, sampler2DUniforms);',
+		'\tcheckGLError();',
+		'}',
+		'#endif',
+		''
+	);
+
+	const render = [
+		'',
+		'#ifdef uniformTime',
+		'uniformTime = time;',
+		'#endif',
+		'',
+		'#ifdef UNIFORM_BLOCK',
+		'uniformBlockUpdate();',
+		'#endif',
+		'',
+	];
+
+	const writtenNames: string[] = [];
+	let currentDivisor = 1;
+	passes.forEach((pass, index) => {
+		const divisor =
+			pass.outputs.length > 0 ? targets[pass.outputs[0]].divisor : 1;
+
+		let framebuffer = '0';
+		if (framebufferIndices[index] !== -1) {
+			framebuffer = `renderGraphFramebuffers[${framebufferIndices[index]}${
+				framebufferFeedbacks[index] ? ' + renderGraphFrame' : ''
+			}]`;
+		}
+
+		render.push(
+			`// Pass ${index}` +
+				(pass.outputs.length > 0 ? `: ${pass.outputs.join(', ')}` : ''),
+			'',
+			`PROFILE_BEGIN("pass ${index}");`,
+			''
+		);
+
+		if (glState) {
+			render.push(`glStateBindFramebuffer(${framebuffer});`);
+		} else {
+			render.push(
+				`glBindFramebuffer(GL_FRAMEBUFFER, ${framebuffer});`,
+				'checkGLError();'
+			);
+		}
+
+		if (divisor !== currentDivisor) {
+			render.push(`glViewport(0, 0, ${getSize(divisor)});`, 'checkGLError();');
+			currentDivisor = divisor;
+		}
+
+		if (pass.clear) {
+			render.push('glClear(GL_COLOR_BUFFER_BIT);', 'checkGLError();');
+		}
+
+		if (glState) {
+			render.push(`glStateUseProgram(programs[${index}]);`);
+		} else {
+			render.push(`glUseProgram(programs[${index}]);`, 'checkGLError();');
+		}
+
+		render.push(
+			'#ifndef UNIFORM_BLOCK',
+			'glUniform1fv(0, FLOAT_UNIFORM_COUNT, floatUniforms);',
+			'checkGLError();',
+			'#endif'
+		);
+
+		// Feedback targets not written yet in this frame hold the previous one.
+		pass.inputs.forEach((name) => {
+			const textureIndex = textureIndices[name];
+			const texture = getTexture(
+				textures[textureIndex],
+				writtenNames.indexOf(name) === -1
+			);
+
+			if (glState) {
+				render.push(`glStateBindTexture(${textureIndex}, ${texture});`);
+			} else {
+				render.push(
+					`glActiveTexture(GL_TEXTURE0 + ${textureIndex});`,
+					'checkGLError();',
+					`glBindTexture(GL_TEXTURE_2D, ${texture});`,
+					'checkGLError();'
+				);
+			}
+		});
+
+		writtenNames.push(...pass.outputs);
+
+		// The state cache sets the blending of every pass, instead of restoring it.
+		if (glState) {
+			render.push(
+				pass.blend
+					? `glStateEnableBlend(${renderGraphBlendFunctions[pass.blend]});`
+					: 'glStateDisableBlend();'
+			);
+		} else if (pass.blend) {
+			render.push(
+				'glEnable(GL_BLEND);',
+				'checkGLError();',
+				`glBlendFunc(${renderGraphBlendFunctions[pass.blend]});`,
+				'checkGLError();'
+			);
+		}
+
+		render.push(
+			'',
+			`#ifdef HAS_HOOK_RENDER_PASS_${index}`,
+			`REPLACE_HOOK_RENDER_PASS_${index}`,
+			'#else',
+			getDrawCall(pass.draw),
+			'checkGLError();',
+			'#endif',
+			''
+		);
+
+		if (!glState && pass.blend) {
+			render.push('glDisable(GL_BLEND);', 'checkGLError();', '');
+		}
+
+		render.push('PROFILE_END();', '');
+	});
+
+	if (currentDivisor !== 1) {
+		render.push(`glViewport(0, 0, ${getSize(1)});`, 'checkGLError();', '');
+	}
+
+	if (hasFeedback) {
+		render.push('renderGraphFrame ^= 1;', '');
+	}
+
+	addToHook(hooks, 'declarations', declarations);
+	addToHook(hooks, 'initialize', initialize);
+	addToHook(hooks, 'render', render);
+}
@@ -1,6 +1,11 @@
 import { watch as originalWatch } from 'gulp';
 import { join, resolve } from 'path';
 
+import {
+	IBenchmarkResult,
+	runBenchmark,
+	writeBenchmarkReport,
+} from './benchmark';
 import { encode as originalEncode, spawnCapture } from './capture';
 import { compile } from './compilation';
 import { provideContext } from './context';
@@ -22,7 +27,9 @@ async function buildDemo(context: IContext) {
 	const demo = await provideDemo(context);
 
 	await writeDemoData(context, demo);
-	await writeDemoGl(context);
+	if (!context.config.get('headless')) {
+		await writeDemoGl(context, demo);
+	}
 	await writeDemoMain(context, demo);
 
 	await compile(context, demo);
@@ -61,6 +68,26 @@ function watchWithContext(context: IContext) {
 	);
 }
 
+export async function benchmark() {
+	const context = provideContext({
+		benchmark: true,
+	});
+
+	const results: IBenchmarkResult[] = [];
+
+	// The resolution is compiled into the shader, so the demo is built for each one.
+	for (const resolution of context.config.get('benchmark:resolutions')) {
+		context.config.set('demo:resolution:width', resolution.width);
+		context.config.set('demo:resolution:height', resolution.height);
+
+		await buildDemo(context);
+
+		results.push(await runBenchmark(context, resolution));
+	}
+
+	await writeBenchmarkReport(context, results);
+}
+
 export function build() {
 	const context = provideContext({});
 
@@ -76,7 +103,9 @@ export async function capture() {
 
 	await spawnCapture(context);
 
-	await originalEncode(context);
+	if (context.config.get('capture:output') !== 'pipe') {
+		await originalEncode(context);
+	}
 }
 
 export async function clean() {
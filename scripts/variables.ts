@@ -40,3 +40,13 @@ export function addUniform(variables: Variable[], type: string, name: string) {
 	};
 	variables.push(variable);
 }
+
+// Name of the macro giving access to the uniform value in C++ code.
+export function getUniformMacroName(name: string) {
+	return (
+		'uniform' +
+		name
+			.replace(/^\w|\b\w/g, (letter) => letter.toUpperCase())
+			.replace(/_+/g, '')
+	);
+}